@@ -0,0 +1,56 @@
+#pragma once
+
+#include "message_definitions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace mi
+{
+    template<std::size_t Capacity> struct BatchBuilder
+    {
+        explicit BatchBuilder(uint8_t batch_size_ = StreamConfig{}.batch_size) :
+            batch_size{batch_size_}
+        {
+        }
+
+        // Appends a spectrum and returns the batch once it's full. A batch closes early when the
+        // next spectrum wouldn't fit the buffer, and a change in band count drops the spectra
+        // collected so far. The returned batch views the builder's buffer and is valid until the
+        // next call.
+        [[nodiscard]] auto push(std::span<const uint8_t> amplitudes) -> std::optional<FourierBatch>;
+        void reset() { count = 0; }
+
+        uint8_t batch_size;
+
+    private:
+        std::array<uint8_t, FourierBatch::header_size + Capacity> buffer;
+        std::size_t bands = 0;
+        uint8_t count = 0;
+    };
+
+    template<std::size_t Capacity>
+    auto BatchBuilder<Capacity>::push(std::span<const uint8_t> amplitudes)
+        -> std::optional<FourierBatch>
+    {
+        if (amplitudes.empty() || amplitudes.size() > Capacity) return std::nullopt;
+        if (amplitudes.size() != bands) reset();
+
+        bands = amplitudes.size();
+        std::ranges::copy(amplitudes, buffer.begin() + FourierBatch::header_size + count * bands);
+        ++count;
+
+        const std::size_t fits = Capacity / bands;
+        if (count < batch_size && count < fits) return std::nullopt;
+
+        buffer[0] = count;
+        buffer[1] = bands & UINT8_MAX;
+        buffer[2] = bands >> UINT8_WIDTH;
+        FourierBatch batch{{buffer.begin(), FourierBatch::header_size + count * bands}};
+        reset();
+        return batch;
+    }
+} // namespace mi
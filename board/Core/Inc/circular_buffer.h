@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <span>
 
 namespace mi {
 
@@ -57,13 +60,40 @@ public:
 template<std::size_t Capacity>
 class tx_circular_buffer : public base_circular_buffer<Capacity> {
 public:
+	// Bytes that fit without overwriting any not sent yet, one slot stays empty to tell a full
+	// buffer from an empty one. The interrupt only ever frees more.
+	auto free() -> std::size_t {
+		const uint8_t *sending = this->read;
+		const std::size_t used = (this->write - sending + Capacity) % Capacity;
+		return Capacity - 1 - used;
+	}
+
 	void push(uint8_t datum) {
+		if (free() == 0)
+			return;
 		*this->write = datum;
 		__disable_irq();
 		this->ptr_increment(&this->write);
 		__enable_irq();
 	}
 
+	// Copies the whole chunk with at most two memcpys and a single critical section. A chunk
+	// that doesn't fit is dropped rather than overwrite bytes still waiting for the line.
+	void push(std::span<const uint8_t> datums) {
+		if (datums.size() > free())
+			return;
+		std::size_t until_end = this->data.end() - this->write;
+		std::size_t first = std::min(datums.size(), until_end);
+		std::memcpy(this->write, datums.data(), first);
+		std::memcpy(this->data.begin(), datums.data() + first, datums.size() - first);
+		uint8_t *next = datums.size() < until_end ?
+				this->write + datums.size() :
+				this->data.begin() + (datums.size() - until_end);
+		__disable_irq();
+		this->write = next;
+		__enable_irq();
+	}
+
 	void start_transmission() {
 		HAL_UART_Transmit_IT(&this->uart, this->read, 1);
 	}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "message_definitions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace mi
+{
+    // Deltas between consecutive frames are zig-zag coded and packed into nibbles, low nibble
+    // first. A nibble up to `max_literal` is a delta on its own, `zero_run` is followed by a
+    // nibble holding the length of a run of unchanged bands and `escape` by two nibbles holding
+    // the raw amplitude, for the rare jumps that don't fit a literal.
+    namespace delta
+    {
+        constexpr static uint8_t max_literal = 13;
+        constexpr static uint8_t zero_run = 14;
+        constexpr static uint8_t escape = 15;
+        constexpr static std::size_t min_run = 2;
+        constexpr static std::size_t max_run = min_run + 15;
+
+        [[nodiscard]] constexpr auto zigzag(int16_t value) -> uint16_t
+        {
+            return static_cast<uint16_t>((value << 1) ^ (value >> 15));
+        }
+
+        [[nodiscard]] constexpr auto unzigzag(uint16_t value) -> int16_t
+        {
+            return static_cast<int16_t>((value >> 1) ^ -(value & 1));
+        }
+
+        struct NibbleWriter
+        {
+            explicit NibbleWriter(std::span<uint8_t> out_) : out{out_} {}
+
+            [[nodiscard]] auto put(uint8_t nibble) -> bool
+            {
+                if (nibbles == out.size() * 2) return false;
+                auto& byte = out[nibbles / 2];
+                byte = nibbles % 2 == 0 ? nibble : byte | (nibble << 4);
+                ++nibbles;
+                return true;
+            }
+            [[nodiscard]] auto size() const -> std::size_t { return (nibbles + 1) / 2; }
+
+        private:
+            std::span<uint8_t> out;
+            std::size_t nibbles = 0;
+        };
+
+        struct NibbleReader
+        {
+            explicit NibbleReader(std::span<const uint8_t> in_) : in{in_} {}
+
+            [[nodiscard]] auto take() -> std::optional<uint8_t>
+            {
+                if (nibbles == in.size() * 2) return std::nullopt;
+                uint8_t byte = in[nibbles / 2];
+                return nibbles++ % 2 == 0 ? byte & 0x0F : byte >> 4;
+            }
+
+        private:
+            std::span<const uint8_t> in;
+            std::size_t nibbles = 0;
+        };
+    } // namespace delta
+
+    template<std::size_t MaxBands> struct DeltaEncoder
+    {
+        explicit DeltaEncoder(uint8_t keyframe_interval_ = StreamConfig{}.keyframe_interval) :
+            keyframe_interval{keyframe_interval_}
+        {
+        }
+
+        // The returned frame views the encoder's buffer and is valid until the next call
+        [[nodiscard]] auto encode(std::span<const uint8_t> amplitudes)
+            -> tl::expected<FourierDelta, Error>;
+        void force_keyframe() { since_keyframe = keyframe_interval; }
+
+        uint8_t keyframe_interval;
+
+    private:
+        [[nodiscard]] auto pack(std::span<const uint8_t> amplitudes, std::span<uint8_t> out)
+            -> std::optional<std::size_t>;
+
+        std::array<uint8_t, MaxBands> previous{};
+        std::size_t previous_bands = 0;
+        uint8_t next_seq = 0;
+        uint8_t since_keyframe = UINT8_MAX;
+        std::array<uint8_t, FourierDelta::header_size + MaxBands> buffer;
+    };
+
+    template<std::size_t MaxBands>
+    auto DeltaEncoder<MaxBands>::encode(std::span<const uint8_t> amplitudes)
+        -> tl::expected<FourierDelta, Error>
+    {
+        if (amplitudes.size() > MaxBands) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        std::span<uint8_t> payload{buffer.begin() + FourierDelta::header_size, amplitudes.size()};
+        std::optional<std::size_t> packed_size;
+        if (since_keyframe < keyframe_interval && previous_bands == amplitudes.size())
+            packed_size = pack(amplitudes, payload);
+
+        // A delta that doesn't beat the raw amplitudes is sent as a keyframe instead
+        const bool keyframe = !packed_size.has_value();
+        if (keyframe)
+        {
+            std::ranges::copy(amplitudes, payload.begin());
+            packed_size = amplitudes.size();
+            since_keyframe = 0;
+        }
+        ++since_keyframe;
+
+        buffer[0] = next_seq++;
+        buffer[1] = static_cast<uint8_t>(keyframe);
+        buffer[2] = amplitudes.size() & UINT8_MAX;
+        buffer[3] = amplitudes.size() >> UINT8_WIDTH;
+        std::ranges::copy(amplitudes, previous.begin());
+        previous_bands = amplitudes.size();
+
+        return FourierDelta{{buffer.begin(), FourierDelta::header_size + *packed_size}};
+    }
+
+    template<std::size_t MaxBands>
+    auto DeltaEncoder<MaxBands>::pack(std::span<const uint8_t> amplitudes, std::span<uint8_t> out)
+        -> std::optional<std::size_t>
+    {
+        delta::NibbleWriter writer{out};
+        std::size_t run = 0;
+        auto flush_run = [&writer, &run]() -> bool
+        {
+            bool fits = true;
+            if (run >= delta::min_run)
+            {
+                fits = writer.put(delta::zero_run) && writer.put(run - delta::min_run);
+            }
+            else if (run == 1)
+            {
+                fits = writer.put(delta::zigzag(0));
+            }
+            run = 0;
+            return fits;
+        };
+
+        for (std::size_t i = 0; i < amplitudes.size(); ++i)
+        {
+            const auto diff = static_cast<int16_t>(amplitudes[i] - previous[i]);
+            if (diff == 0)
+            {
+                if (++run == delta::max_run && !flush_run()) return std::nullopt;
+                continue;
+            }
+            if (!flush_run()) return std::nullopt;
+
+            const uint16_t zigzagged = delta::zigzag(diff);
+            const bool fits = zigzagged <= delta::max_literal
+                                  ? writer.put(zigzagged)
+                                  : writer.put(delta::escape) && writer.put(amplitudes[i] & 0x0F)
+                                        && writer.put(amplitudes[i] >> 4);
+            if (!fits) return std::nullopt;
+        }
+        if (!flush_run()) return std::nullopt;
+        if (writer.size() >= amplitudes.size()) return std::nullopt;
+        return writer.size();
+    }
+
+    template<std::size_t MaxBands> struct DeltaDecoder
+    {
+        // The returned amplitudes view the decoder's state and are valid until the next call.
+        // After a lost frame every delta is rejected until the next keyframe arrives.
+        [[nodiscard]] auto decode(const FourierDelta& delta)
+            -> tl::expected<std::span<uint8_t>, Error>;
+
+    private:
+        [[nodiscard]] auto unpack(std::span<const uint8_t> packed) -> bool;
+
+        std::array<uint8_t, MaxBands> current{};
+        std::size_t bands = 0;
+        uint8_t expected_seq = 0;
+        bool synced = false;
+    };
+
+    template<std::size_t MaxBands>
+    auto DeltaDecoder<MaxBands>::decode(const FourierDelta& delta)
+        -> tl::expected<std::span<uint8_t>, Error>
+    {
+        if (delta.bands() > MaxBands) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        if (delta.keyframe())
+        {
+            std::ranges::copy(delta.packed(), current.begin());
+            bands = delta.bands();
+        }
+        else if (!synced || delta.seq() != expected_seq || delta.bands() != bands)
+        {
+            synced = false;
+            return tl::unexpected{Error::MISSING_KEYFRAME};
+        }
+        else if (!unpack(delta.packed()))
+        {
+            synced = false;
+            return tl::unexpected{Error::INCOMPLETE};
+        }
+
+        synced = true;
+        expected_seq = delta.seq() + 1;
+        return std::span<uint8_t>{current.begin(), bands};
+    }
+
+    template<std::size_t MaxBands>
+    auto DeltaDecoder<MaxBands>::unpack(std::span<const uint8_t> packed) -> bool
+    {
+        delta::NibbleReader reader{packed};
+        std::size_t i = 0;
+        while (i < bands)
+        {
+            auto nibble = reader.take();
+            if (!nibble) return false;
+            if (*nibble == delta::zero_run)
+            {
+                auto run = reader.take();
+                if (!run) return false;
+                i += *run + delta::min_run;
+            }
+            else if (*nibble == delta::escape)
+            {
+                auto low = reader.take();
+                auto high = reader.take();
+                if (!low || !high) return false;
+                current[i++] = *low | (*high << 4);
+            }
+            else
+            {
+                current[i] = current[i] + delta::unzigzag(*nibble);
+                ++i;
+            }
+        }
+        return i == bands;
+    }
+} // namespace mi
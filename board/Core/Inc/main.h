@@ -61,7 +61,10 @@ void Error_Handler(void);
 #define LD2_GPIO_Port GPIOA
 
 /* USER CODE BEGIN Private defines */
-
+/* Rate of the link to the host, the host tools take the same rate with -b */
+#ifndef MI_UART_BAUD_RATE
+#define MI_UART_BAUD_RATE 115200
+#endif
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
@@ -31,6 +31,9 @@ namespace mi
         UNKNOWN_MSG_ID,      // 6
         OUT_OF_MEMORY,       // 7
         MESSAGE_NOT_READY,   // 8
+        MISSING_KEYFRAME,    // 9
+        TIMED_OUT,           // 10
+        LINK_CLOSED,         // 11
     };
 
     struct data_view;
@@ -212,6 +215,21 @@ namespace mi
         constexpr static uint8_t encoder = 0xFC;
     } // namespace magic
 
+    constexpr static uint16_t crc16_init = 0xFFFF;
+
+    // Feeds one more byte into a running CRC, started from `crc16_init`
+    [[nodiscard]] constexpr auto crc16_update(uint16_t crc, uint8_t byte) -> uint16_t
+    {
+        uint8_t x = crc >> 8 ^ byte;
+        x ^= x >> 4;
+        // clang-format off
+        return (crc << 8)
+               ^ (static_cast<uint16_t>(x << 12))
+               ^ (static_cast<uint16_t>(x << 5))
+               ^ (static_cast<uint16_t>(x));
+        // clang-format on
+    }
+
 #ifdef MI_IMPLEMENT
     auto operator<<(std::ostream& os, const encoded_data_view& view) -> std::ostream&
     {
@@ -224,18 +242,10 @@ namespace mi
 
     [[nodiscard]] auto crc16(data_view data) -> uint16_t
     {
-        uint8_t x;
-        uint16_t crc = 0xFFFF;
+        uint16_t crc = crc16_init;
         for (auto c : data)
         {
-            x = crc >> 8 ^ c;
-            x ^= x >> 4;
-            // clang-format off
-            crc = (crc << 8)
-                  ^ (static_cast<uint16_t>(x << 12))
-                  ^ (static_cast<uint16_t>(x << 5))
-                  ^ (static_cast<uint16_t>(x));
-            // clang-format on
+            crc = crc16_update(crc, c);
         }
         return crc;
     }
@@ -2,11 +2,21 @@
 
 #include "main.hpp"
 
+#include <algorithm>
+#include <ranges>
 #include <span>
 #include <variant>
 
 namespace mi
 {
+    // Upper bounds of the variable sized messages, the buffers on both ends are sized from them
+    namespace limits
+    {
+        constexpr static std::size_t max_bands = 256;    // Spectra of a 512 point transform
+        constexpr static std::size_t max_samples = 512;  // Half of the board's ADC buffer
+        constexpr static std::size_t max_batched = 1024; // Bytes of spectra in a FourierBatch
+    } // namespace limits
+
 #pragma pack(push, 1)
     struct Heartbeat
     {
@@ -16,11 +26,43 @@ namespace mi
 
         [[nodiscard]] constexpr auto operator==(const Heartbeat&) const -> bool = default;
     };
+
+    // Grants the board credits for `number_of_datums` more frames
+    struct StartStreamingData
+    {
+        constexpr static uint16_t id = 3;
+
+        uint32_t number_of_datums;
+
+        [[nodiscard]] constexpr auto operator==(const StartStreamingData&) const -> bool = default;
+    };
+
+    enum struct FrameEncoding : uint8_t
+    {
+        PLAIN,     // FourierData
+        DELTA,     // FourierDelta
+        PACKED,    // PackedFourierData
+        RAW,       // RawSamples packed at 12 bits, the host runs the transform
+        RAW_DELTA, // RawSamples delta coded whenever that beats packing
+    };
+
+    struct StreamConfig
+    {
+        constexpr static uint16_t id = 5;
+
+        FrameEncoding encoding = FrameEncoding::PLAIN;
+        uint8_t keyframe_interval = 32;
+        uint8_t bits = 6;
+        uint8_t batch_size = 1; // Plain spectra per FourierBatch, 1 sends plain FourierData
+
+        [[nodiscard]] constexpr auto operator==(const StreamConfig&) const -> bool = default;
+    };
 #pragma pack(pop)
 
     struct FourierData
     {
         constexpr static uint16_t id = 4;
+        constexpr static std::size_t max_payload_size = limits::max_bands;
 
         explicit FourierData(std::span<uint8_t> amplitudes_);
 
@@ -39,38 +81,252 @@ namespace mi
     static_assert(explicitly_serializable<FourierData>);
     static_assert(explicitly_deserializable<FourierData>);
 
-    using Message = std::variant<Heartbeat, FourierData>;
+    // Amplitudes coded against the previous frame, see delta_codec.hpp. The span holds the whole
+    // serialized frame: sequence number, keyframe flag, band count and the packed payload.
+    struct FourierDelta
+    {
+        constexpr static uint16_t id = 6;
+        constexpr static std::size_t header_size = 4;
+        constexpr static std::size_t max_payload_size = header_size + limits::max_bands;
 
-    [[nodiscard]] auto static_type(message_t& message) -> std::pair<Message, std::optional<Error>>;
-} // namespace mi
-#ifdef MI_IMPLEMENT
-namespace mi
-{
-    auto static_type(message_t& message) -> std::pair<Message, std::optional<Error>>
+        explicit FourierDelta(std::span<uint8_t> frame_);
+
+        [[nodiscard]] static auto deserialize(data_view& data) -> tl::expected<FourierDelta, Error>;
+        [[nodiscard]] auto serialize() -> data_view;
+
+        [[nodiscard]] auto seq() const -> uint8_t { return frame[0]; }
+        [[nodiscard]] auto keyframe() const -> bool { return frame[1] != 0; }
+        [[nodiscard]] auto bands() const -> uint16_t
+        {
+            return (static_cast<uint16_t>(frame[3]) << UINT8_WIDTH) + frame[2];
+        }
+        [[nodiscard]] auto packed() const -> std::span<uint8_t>
+        {
+            return frame.subspan(header_size);
+        }
+
+        std::span<uint8_t> frame;
+
+        [[nodiscard]] constexpr auto operator==(const FourierDelta& other) const -> bool
+        {
+            return frame.size() == other.frame.size()
+                   && std::equal(frame.begin(), frame.end(), other.frame.begin());
+        }
+    };
+
+    static_assert(explicitly_serializable<FourierDelta>);
+    static_assert(explicitly_deserializable<FourierDelta>);
+
+    // Amplitudes cut down to their `bits` most significant bits, see bit_pack.hpp. Like
+    // FourierDelta, the span holds the whole serialized frame: width, band count and payload.
+    struct PackedFourierData
+    {
+        constexpr static uint16_t id = 7;
+        constexpr static std::size_t header_size = 3;
+        constexpr static std::size_t max_payload_size = header_size + limits::max_bands;
+
+        explicit PackedFourierData(std::span<uint8_t> frame_);
+
+        [[nodiscard]] static auto deserialize(data_view& data)
+            -> tl::expected<PackedFourierData, Error>;
+        [[nodiscard]] auto serialize() -> data_view;
+
+        [[nodiscard]] auto bits() const -> uint8_t { return frame[0]; }
+        [[nodiscard]] auto bands() const -> uint16_t
+        {
+            return (static_cast<uint16_t>(frame[2]) << UINT8_WIDTH) + frame[1];
+        }
+        [[nodiscard]] auto packed() const -> std::span<uint8_t>
+        {
+            return frame.subspan(header_size);
+        }
+
+        std::span<uint8_t> frame;
+
+        [[nodiscard]] constexpr auto operator==(const PackedFourierData& other) const -> bool
+        {
+            return frame.size() == other.frame.size()
+                   && std::equal(frame.begin(), frame.end(), other.frame.begin());
+        }
+    };
+
+    static_assert(explicitly_serializable<PackedFourierData>);
+    static_assert(explicitly_deserializable<PackedFourierData>);
+
+    // Several spectra of equal length behind a single header and CRC, see batch.hpp. The span
+    // holds the whole serialized frame: spectra count, band count and the spectra back to back.
+    struct FourierBatch
+    {
+        constexpr static uint16_t id = 8;
+        constexpr static std::size_t header_size = 3;
+        constexpr static std::size_t max_payload_size = header_size + limits::max_batched;
+
+        explicit FourierBatch(std::span<uint8_t> frame_);
+
+        [[nodiscard]] static auto deserialize(data_view& data) -> tl::expected<FourierBatch, Error>;
+        [[nodiscard]] auto serialize() -> data_view;
+
+        [[nodiscard]] auto count() const -> uint8_t { return frame[0]; }
+        [[nodiscard]] auto bands() const -> uint16_t
+        {
+            return (static_cast<uint16_t>(frame[2]) << UINT8_WIDTH) + frame[1];
+        }
+        [[nodiscard]] auto spectrum(std::size_t index) const -> std::span<uint8_t>
+        {
+            return frame.subspan(header_size + index * bands(), bands());
+        }
+        // Views of the contained spectra, nothing is copied
+        [[nodiscard]] auto spectra() const
+        {
+            auto view_spectrum = [*this](std::size_t index) { return spectrum(index); };
+            return std::views::iota(std::size_t{0}, std::size_t{count()})
+                   | std::views::transform(view_spectrum);
+        }
+
+        std::span<uint8_t> frame;
+
+        [[nodiscard]] constexpr auto operator==(const FourierBatch& other) const -> bool
+        {
+            return frame.size() == other.frame.size()
+                   && std::equal(frame.begin(), frame.end(), other.frame.begin());
+        }
+    };
+
+    static_assert(explicitly_serializable<FourierBatch>);
+    static_assert(explicitly_deserializable<FourierBatch>);
+
+    // A block of 12 bit ADC samples, see raw_samples.hpp. The span holds the whole serialized
+    // frame: sequence number, coding, sample count and the coded samples.
+    struct RawSamples
     {
-        // TODO: Some std::variant_alternative_t bs if I get the motivation to do it which I
-        // probably won't
-    	Message out;
-    	std::optional<Error> err;
-        switch (message.msg_id)
+        constexpr static uint16_t id = 9;
+        constexpr static std::size_t header_size = 4;
+        constexpr static std::size_t sample_bits = 12;
+        constexpr static std::size_t max_payload_size =
+            header_size + (limits::max_samples * sample_bits + UINT8_WIDTH - 1) / UINT8_WIDTH;
+        constexpr static uint8_t packed_coding = 0;
+        constexpr static uint8_t delta_coding = 1;
+
+        explicit RawSamples(std::span<uint8_t> frame_);
+
+        [[nodiscard]] static auto deserialize(data_view& data) -> tl::expected<RawSamples, Error>;
+        [[nodiscard]] auto serialize() -> data_view;
+
+        [[nodiscard]] auto seq() const -> uint8_t { return frame[0]; }
+        [[nodiscard]] auto coding() const -> uint8_t { return frame[1]; }
+        [[nodiscard]] auto count() const -> uint16_t
         {
-        case Heartbeat::id:
+            return (static_cast<uint16_t>(frame[3]) << UINT8_WIDTH) + frame[2];
+        }
+        [[nodiscard]] auto coded() const -> std::span<uint8_t>
+        {
+            return frame.subspan(header_size);
+        }
+
+        std::span<uint8_t> frame;
+
+        [[nodiscard]] constexpr auto operator==(const RawSamples& other) const -> bool
+        {
+            return frame.size() == other.frame.size()
+                   && std::equal(frame.begin(), frame.end(), other.frame.begin());
+        }
+    };
+
+    static_assert(explicitly_serializable<RawSamples>);
+    static_assert(explicitly_deserializable<RawSamples>);
+
+    using Message = std::variant<Heartbeat,
+                                 StartStreamingData,
+                                 FourierData,
+                                 StreamConfig,
+                                 FourierDelta,
+                                 PackedFourierData,
+                                 FourierBatch,
+                                 RawSamples>;
+
+    template<typename Type> [[nodiscard]] consteval auto max_payload_size() -> std::size_t
+    {
+        if constexpr (explicitly_serializable<Type>)
+            return Type::max_payload_size;
+        else
+            return sizeof(Type);
+    }
+
+    // STX, message id, payload, CRC and ETX of the largest of the messages
+    template<typename... Types>
+    constexpr std::size_t max_serialized_size =
+        std::max({(sizeof(magic::stx) + sizeof(uint16_t) + max_payload_size<Types>()
+                   + sizeof(uint16_t) + sizeof(magic::etx))...});
+    template<typename... Types>
+    constexpr std::size_t max_serialized_size<std::variant<Types...>> =
+        max_serialized_size<Types...>;
+
+    // Worst case on the wire, with every byte between STX and ETX escaped
+    template<typename... Types>
+    constexpr std::size_t max_encoded_size =
+        2 * max_serialized_size<Types...> - sizeof(magic::stx) - sizeof(magic::etx);
+    template<typename... Types>
+    constexpr std::size_t max_encoded_size<std::variant<Types...>> = max_encoded_size<Types...>;
+
+    namespace detail
+    {
+        using Deserializer = auto (*)(data_view&, Message&) -> std::optional<Error>;
+
+        // Builds the alternative in place, trivially copyable messages are copied straight into
+        // the variant's storage
+        template<std::size_t Index>
+        auto deserialize_alternative(data_view& payload, Message& out) -> std::optional<Error>
         {
-        	auto msg = message.payload.deserialize_into<Heartbeat>();
-        	if (msg) out = *msg;
-        	else err = msg.error();
-        	break;
+            using Alternative = std::variant_alternative_t<Index, Message>;
+            if constexpr (implicitly_deserializable<Alternative>)
+            {
+                if (sizeof(Alternative) != payload.size()) return Error::INCORRECT_ALIGNMENT;
+                std::memcpy(&out.template emplace<Index>(), payload.data(), sizeof(Alternative));
+            }
+            else
+            {
+                auto typed = Alternative::deserialize(payload);
+                if (!typed) return typed.error();
+                out.template emplace<Index>(*typed);
+            }
+            return std::nullopt;
         }
-        case FourierData::id:
+
+        template<std::size_t... Indices>
+        constexpr auto make_dispatch_table(std::index_sequence<Indices...>)
         {
-        	auto msg = message.payload.deserialize_into<FourierData>();
-        	if (msg) out = *msg;
-        	else err = msg.error();
-        	break;
+            constexpr std::array ids{std::variant_alternative_t<Indices, Message>::id...};
+            std::array<Deserializer, *std::ranges::max_element(ids) + 1> table{};
+            ((table[ids[Indices]] = &deserialize_alternative<Indices>), ...);
+            return table;
         }
-        default: err = Error::UNKNOWN_MSG_ID;
+
+        template<std::size_t... Indices>
+        constexpr auto unique_ids(std::index_sequence<Indices...> indices) -> bool
+        {
+            auto table = make_dispatch_table(indices);
+            return static_cast<std::size_t>(std::ranges::count(table, nullptr))
+                   == table.size() - sizeof...(Indices);
         }
-        return {out, err};
+
+        // Indexed by message id, ids no message uses are left empty
+        constexpr static auto dispatch_table =
+            make_dispatch_table(std::make_index_sequence<std::variant_size_v<Message>>{});
+        static_assert(unique_ids(std::make_index_sequence<std::variant_size_v<Message>>{}),
+                      "Two messages share the same id");
+    } // namespace detail
+
+    [[nodiscard]] auto static_type(message_t& message, Message& out) -> std::optional<Error>;
+} // namespace mi
+#ifdef MI_IMPLEMENT
+namespace mi
+{
+    auto static_type(message_t& message, Message& out) -> std::optional<Error>
+    {
+        if (message.msg_id >= detail::dispatch_table.size()) return Error::UNKNOWN_MSG_ID;
+        auto deserializer = detail::dispatch_table[message.msg_id];
+        if (deserializer == nullptr) return Error::UNKNOWN_MSG_ID;
+        return deserializer(message.payload, out);
     }
 
     FourierData::FourierData(std::span<uint8_t> amplitudes_) : amplitudes{amplitudes_} {}
@@ -90,5 +346,88 @@ namespace mi
             amplitudes.size(),
         };
     }
+
+    FourierDelta::FourierDelta(std::span<uint8_t> frame_) : frame{frame_} {}
+
+    auto FourierDelta::deserialize(mi::data_view& data) -> tl::expected<FourierDelta, Error>
+    {
+        if (data.size() < header_size) return tl::unexpected{Error::NOT_ENOUGH_DATA};
+        FourierDelta delta{{data.begin(), data.size()}};
+        if (delta.keyframe() && delta.packed().size() != delta.bands())
+            return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+        return delta;
+    }
+
+    auto FourierDelta::serialize() -> data_view
+    {
+        return {
+            frame.data(),
+            frame.size(),
+        };
+    }
+
+    PackedFourierData::PackedFourierData(std::span<uint8_t> frame_) : frame{frame_} {}
+
+    auto PackedFourierData::deserialize(mi::data_view& data)
+        -> tl::expected<PackedFourierData, Error>
+    {
+        if (data.size() < header_size) return tl::unexpected{Error::NOT_ENOUGH_DATA};
+        PackedFourierData packed{{data.begin(), data.size()}};
+        if (packed.bits() == 0 || packed.bits() > UINT8_WIDTH
+            || packed.packed().size()
+                   != (std::size_t{packed.bands()} * packed.bits() + UINT8_WIDTH - 1) / UINT8_WIDTH)
+            return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+        return packed;
+    }
+
+    auto PackedFourierData::serialize() -> data_view
+    {
+        return {
+            frame.data(),
+            frame.size(),
+        };
+    }
+
+    FourierBatch::FourierBatch(std::span<uint8_t> frame_) : frame{frame_} {}
+
+    auto FourierBatch::deserialize(mi::data_view& data) -> tl::expected<FourierBatch, Error>
+    {
+        if (data.size() < header_size) return tl::unexpected{Error::NOT_ENOUGH_DATA};
+        FourierBatch batch{{data.begin(), data.size()}};
+        if (batch.frame.size() - header_size != std::size_t{batch.count()} * batch.bands())
+            return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+        return batch;
+    }
+
+    auto FourierBatch::serialize() -> data_view
+    {
+        return {
+            frame.data(),
+            frame.size(),
+        };
+    }
+
+    RawSamples::RawSamples(std::span<uint8_t> frame_) : frame{frame_} {}
+
+    auto RawSamples::deserialize(mi::data_view& data) -> tl::expected<RawSamples, Error>
+    {
+        if (data.size() < header_size) return tl::unexpected{Error::NOT_ENOUGH_DATA};
+        RawSamples samples{{data.begin(), data.size()}};
+        const std::size_t packed_size =
+            (samples.count() * sample_bits + UINT8_WIDTH - 1) / UINT8_WIDTH;
+        const bool aligned = samples.coding() == packed_coding
+                                 ? samples.coded().size() == packed_size
+                                 : samples.coding() == delta_coding;
+        if (!aligned) return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+        return samples;
+    }
+
+    auto RawSamples::serialize() -> data_view
+    {
+        return {
+            frame.data(),
+            frame.size(),
+        };
+    }
 } // namespace mi
 #endif
@@ -8,66 +8,91 @@
 
 namespace mi
 {
+    struct ReceiverStats
+    {
+        std::size_t resyncs = 0;         // Frames abandoned because a fresh STX showed up
+        std::size_t overflows = 0;       // Frames abandoned because they didn't fit the buffer
+        std::size_t crc_failures = 0;    // Complete frames rejected by the CRC check
+        std::size_t discarded_bytes = 0; // Bytes that never made it into a collected frame
+    };
+
+    // Every STX starts a new frame, whatever state the receiver is in, and a frame that outgrows
+    // the buffer is dropped on the spot, so a corrupted link costs at most the frame in flight.
     template<std::size_t MessageBufferSize> struct Receiver
     {
         void put(uint8_t byte);
         [[nodiscard]] auto collect(Message& out) -> std::optional<Error>;
         [[nodiscard]] auto ready() -> bool { return reception_state == ETX_RECEIVED; }
+        [[nodiscard]] auto stats() const -> const ReceiverStats& { return statistics; }
 
     private:
         void reset();
+        void restart();
+        void drop_frame();
+        [[nodiscard]] auto frame_size() const -> std::size_t
+        {
+            return recv_ptr - encoded_recv_buffer.data();
+        }
 
         enum ReceptionState
         {
             IDLE,
             STX_RECEIVED,
             ETX_RECEIVED,
-            NO_MORE_SPACE
         };
 
         std::array<uint8_t, MessageBufferSize> recv_buffer;
         std::array<uint8_t, MessageBufferSize> encoded_recv_buffer;
         uint8_t* recv_ptr = &encoded_recv_buffer[0];
         ReceptionState reception_state = IDLE;
+        ReceiverStats statistics;
     };
 
     template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::put(uint8_t byte)
     {
-        *(recv_ptr++) = byte;
         if (byte == magic::stx)
         {
-            reception_state = STX_RECEIVED;
+            restart();
             return;
         }
-        if (byte == magic::etx && reception_state == STX_RECEIVED)
+        if (reception_state != STX_RECEIVED)
         {
-            reception_state = ETX_RECEIVED;
+            ++statistics.discarded_bytes;
             return;
         }
+        if (recv_ptr == encoded_recv_buffer.end())
+        {
+            ++statistics.overflows;
+            ++statistics.discarded_bytes;
+            drop_frame();
+            return;
+        }
+        *(recv_ptr++) = byte;
+        if (byte == magic::etx) reception_state = ETX_RECEIVED;
     }
 
-    // Out parameter is because it's too much for STM32 to handle double type erasure lol
+    // Out parameter is because it's too much for STM32 to handle double type erasure lol,
+    // static_type builds the message right in it
     template<std::size_t MessageBufferSize>
     auto Receiver<MessageBufferSize>::collect(Message& out) -> std::optional<Error>
     {
         if (!ready()) return Error::MESSAGE_NOT_READY;
-        reset();
 
-        auto encoded_view = encoded_data_view{encoded_recv_buffer};
+        // The buffer always starts at the STX and ends at the ETX, no need to search for them
+        auto encoded_view = encoded_data_view{encoded_recv_buffer.data(), frame_size()};
         auto message_view = data_view{recv_buffer};
-        auto truncated = message_t::truncate(encoded_view);
+        reset();
 
-        if (!truncated) return truncated.error();
-        if (auto error = truncated->decode(message_view)) return error.value();
+        if (auto error = encoded_view.decode(message_view)) return error.value();
 
         auto message = message_t::deserialize(message_view);
-        if (!message) return message.error();
-
-        auto [statically_typed, error] = static_type(message.value());
-        if (error) return error;
-    	out = statically_typed;
+        if (!message)
+        {
+            if (message.error() == Error::INVALID_CRC) ++statistics.crc_failures;
+            return message.error();
+        }
 
-        return std::nullopt;
+        return static_type(message.value(), out);
     }
 
     template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::reset()
@@ -75,4 +100,22 @@ namespace mi
         recv_ptr = &encoded_recv_buffer[0];
         reception_state = IDLE;
     }
+
+    template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::restart()
+    {
+        if (reception_state == STX_RECEIVED)
+        {
+            ++statistics.resyncs;
+            statistics.discarded_bytes += frame_size();
+        }
+        recv_ptr = &encoded_recv_buffer[0];
+        *(recv_ptr++) = magic::stx;
+        reception_state = STX_RECEIVED;
+    }
+
+    template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::drop_frame()
+    {
+        statistics.discarded_bytes += frame_size();
+        reset();
+    }
 } // namespace mi
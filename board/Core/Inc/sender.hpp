@@ -2,52 +2,92 @@
 
 #include "message_definitions.hpp"
 
+#include <array>
+#include <span>
+
 namespace mi
 {
-    template<std::size_t MessageBufferSize> struct Sender
+    // Receives the encoded stream in chunks of at most the sender's chunk size
+    template<typename Sink>
+    concept byte_sink = requires(Sink& sink, std::span<const uint8_t> bytes) { sink(bytes); };
+
+    // Serializes, checksums and escapes in a single pass over the message, so nothing but a
+    // chunk of already encoded bytes is ever staged, whatever the size of the message. A message
+    // that encodes to at most `ChunkSize` bytes reaches the sink in one call. The sink is a
+    // template parameter so a functor or lambda type gets inlined into send, the default function
+    // pointer keeps plain callbacks working.
+    template<std::size_t ChunkSize, byte_sink Sink = void (*)(std::span<const uint8_t>)>
+    struct Sender
     {
-        using CallbackType = void (*)(uint8_t);
+        static_assert(ChunkSize >= 2, "An escaped byte must fit a single chunk");
 
-        Sender(CallbackType callback_) : callback{callback_} {};
+        Sender(Sink sink_) : sink{sink_} {};
         template<std::convertible_to<Message> ConcreteMessage>
         [[nodiscard]] auto send(ConcreteMessage& message) -> std::optional<Error>;
 
     private:
-        auto encode_message(data_view& view) -> tl::expected<encoded_data_view, Error>;
+        void put(uint8_t byte);
+        void put_escaped(uint8_t byte);
+        void flush();
 
-        CallbackType callback;
+        Sink sink;
 
-        std::array<uint8_t, MessageBufferSize> send_buffer;
-        std::array<uint8_t, MessageBufferSize * 2> encoded_send_buffer;
+        std::array<uint8_t, ChunkSize> chunk;
+        std::size_t chunk_size = 0;
     };
 
-    template<std::size_t MessageBufferSize>
+    template<std::size_t ChunkSize, byte_sink Sink>
     template<std::convertible_to<mi::Message> ConcreteMessage>
-    auto Sender<MessageBufferSize>::send(ConcreteMessage& message) -> std::optional<Error>
+    auto Sender<ChunkSize, Sink>::send(ConcreteMessage& message) -> std::optional<Error>
     {
-        auto message_view = data_view{send_buffer};
-        message_t msg = make_message(message);
-        msg.serialize(message_view);
-        auto encoded_view = encode_message(message_view);
-        if (!encoded_view.has_value()) return encoded_view.error();
-        for (auto byte : *encoded_view)
+        auto payload = data_view::from_serialized(message);
+        if (payload.size() > message_t::max_payload_len) return Error::OUT_OF_MEMORY;
+
+        // The CRC covers the raw STX, id and payload. It is escaped along with them, otherwise a
+        // CRC byte equal to STX or ETX would look like a frame boundary to the receiver.
+        uint16_t crc = crc16_update(crc16_init, magic::stx);
+        auto put_checked = [this, &crc](uint8_t byte)
         {
-            callback(byte);
-        }
+            crc = crc16_update(crc, byte);
+            put_escaped(byte);
+        };
+
+        put(magic::stx);
+        put_checked(ConcreteMessage::id & UINT8_MAX);
+        put_checked(ConcreteMessage::id >> UINT8_WIDTH);
+        for (auto c : payload)
+            put_checked(c);
+        put_escaped(crc & UINT8_MAX);
+        put_escaped(crc >> UINT8_WIDTH);
+        put(magic::etx);
+        flush();
         return std::nullopt;
     }
 
-    template<std::size_t MessageBufferSize>
-    auto Sender<MessageBufferSize>::encode_message(data_view& view)
-        -> tl::expected<encoded_data_view, Error>
+    template<std::size_t ChunkSize, byte_sink Sink> void Sender<ChunkSize, Sink>::put(uint8_t byte)
+    {
+        if (chunk_size == chunk.size()) flush();
+        chunk[chunk_size++] = byte;
+    }
+
+    template<std::size_t ChunkSize, byte_sink Sink>
+    void Sender<ChunkSize, Sink>::put_escaped(uint8_t byte)
+    {
+        if (byte < magic::encoder || byte > magic::etx)
+        {
+            put(byte);
+            return;
+        }
+        // Both halves of an escape go out in the same chunk
+        if (chunk_size + 2 > chunk.size()) flush();
+        chunk[chunk_size++] = magic::encoder;
+        chunk[chunk_size++] = byte - magic::encoder;
+    }
+
+    template<std::size_t ChunkSize, byte_sink Sink> void Sender<ChunkSize, Sink>::flush()
     {
-        encoded_send_buffer[0] = magic::stx;
-        encoded_data_view encoded{encoded_send_buffer.begin() + 1, encoded_send_buffer.size() - 1};
-        data_view to_encode_chunk{view.begin() + 1, view.size() - 4};
-        std::optional<Error> error = to_encode_chunk.encode(encoded);
-        if (error) return tl::make_unexpected(error.value());
-        encoded.resize(encoded.size() + 3);
-        std::copy(view.end() - 3, view.end(), encoded.end() - 3);
-        return encoded_data_view{&encoded_send_buffer[0], encoded.size() + 1};
+        if (chunk_size == 0) return;
+        sink(std::span<const uint8_t>{chunk.data(), chunk_size});
+        chunk_size = 0;
     }
-} // namespace mi
\ No newline at end of file
+} // namespace mi
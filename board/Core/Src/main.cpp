@@ -23,6 +23,10 @@
 #include "receiver.hpp"
 #include "fft.hpp"
 #include "sender.hpp"
+#include "delta_codec.hpp"
+#include "bit_pack.hpp"
+#include "batch.hpp"
+#include "raw_samples.hpp"
 #include <cstring>
 #include <cstdio>
 #include <span>
@@ -61,17 +65,32 @@ DMA_HandleTypeDef hdma_adc1;
 TIM_HandleTypeDef htim3;
 
 /* USER CODE BEGIN PV */
-mi::rx_circular_buffer<2000> rx_circ_buf{huart2};
-mi::tx_circular_buffer<6000> tx_circ_buf{huart2};
-void send_callback(uint8_t byte)
+// Room for a burst of host messages, and for the frame being sent next to the one on the wire
+constexpr std::size_t max_inbound_size =
+	mi::max_encoded_size<mi::Heartbeat, mi::StartStreamingData, mi::StreamConfig>;
+constexpr std::size_t max_outbound_size = mi::max_encoded_size<mi::Message>;
+mi::rx_circular_buffer<8 * max_inbound_size> rx_circ_buf{huart2};
+mi::tx_circular_buffer<2 * max_outbound_size> tx_circ_buf{huart2};
+auto send_callback = [](std::span<const uint8_t> bytes)
 {
-	tx_circ_buf.push(byte);
-}
-mi::Receiver<100> receiver;
-mi::Sender<6000> sender{send_callback};
+	tx_circ_buf.push(bytes);
+};
+mi::Receiver<max_inbound_size> receiver;
+mi::Sender<64, decltype(send_callback)> sender{send_callback};
 std::array<uint16_t, 1024> adc_buffer;
 fft_eval_state_t fft_eval_state = fft_eval_state_t::idle;
 uint32_t timeout_counter = 0;
+// Frames the host is willing to take, topped up with StartStreamingData. They only count while
+// the host is heard from: grants before its first heartbeat are ignored and they lapse with the
+// heartbeat, the host grants a whole window again once the stream stalls.
+uint32_t credits = 0;
+mi::StreamConfig stream_config;
+mi::DeltaEncoder<mi::limits::max_bands> delta_encoder;
+mi::BitPacker<mi::limits::max_bands> bit_packer;
+mi::BatchBuilder<mi::limits::max_batched> batch_builder;
+mi::SampleEncoder<mi::limits::max_samples> sample_encoder;
+static_assert(adc_buffer.size() / 2 <= mi::limits::max_samples, "Raw sample blocks outgrow RawSamples");
+static_assert(adc_buffer.size() / 4 <= mi::limits::max_bands, "Spectra outgrow the Fourier messages");
 
 /* USER CODE END PV */
 
@@ -138,7 +157,8 @@ int main(void)
   while (1)
   {
 	reception();
-	if (timeout_counter == 0) continue;
+	if (timeout_counter == 0) credits = 0;
+	if (timeout_counter == 0 || credits == 0) continue;
 	HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin);
 
 	fourier();
@@ -322,7 +342,17 @@ static void MX_USART2_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART2_Init 2 */
-
+  // Rates above PCLK1 / 16 need 8x oversampling. Off the 16 MHz HSI 1 and 2 Mbaud divide
+  // exactly, 921600 comes out 2% fast.
+  if (huart2.Init.BaudRate != MI_UART_BAUD_RATE)
+  {
+    huart2.Init.BaudRate = MI_UART_BAUD_RATE;
+    huart2.Init.OverSampling = MI_UART_BAUD_RATE > HAL_RCC_GetPCLK1Freq() / 16 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart2) != HAL_OK)
+    {
+      Error_Handler();
+    }
+  }
   /* USER CODE END USART2_Init 2 */
 
 }
@@ -397,7 +427,7 @@ void reception(void)
 	while (!rx_circ_buf.is_empty())
 	{
 		receiver.put(rx_circ_buf.pop());
-		if (!receiver.ready()) return;
+		if (!receiver.ready()) continue;
 
 		mi::Message message;
 		auto error = receiver.collect(/*out*/message);
@@ -406,6 +436,17 @@ void reception(void)
 		{
 			std::visit(mi::OverloadSet{
 				[](const mi::Heartbeat&) { timeout_counter = 3000; /* 3s */},
+				[](const mi::StartStreamingData& grant) {
+					if (timeout_counter == 0) return;
+					credits = std::min<uint64_t>(uint64_t{credits} + grant.number_of_datums, UINT32_MAX);
+				},
+				[](const mi::StreamConfig& config) {
+					stream_config = config;
+					delta_encoder.keyframe_interval = config.keyframe_interval;
+					delta_encoder.force_keyframe();
+					batch_builder.batch_size = config.batch_size;
+					batch_builder.reset();
+				},
 				[](const auto&) {},
 			}, message);
 		}
@@ -424,18 +465,57 @@ void fourier(void)
 	constexpr float dt = static_cast<float>(adc_buffer.size() / on_half) / sampling_hz;
 
 	if (fft_eval_state == fft_eval_state_t::idle) return;
+	const bool second_half = fft_eval_state == fft_eval_state_t::eval_second_half;
 	fft_eval_state = fft_eval_state_t::idle;
 
+	// Raw blocks outrun the line at 115200 baud. While the previous frame still takes up the
+	// ring the block is skipped, and its credit stays with the board.
+	if (tx_circ_buf.free() < max_outbound_size) return;
+
 	std::span<const uint16_t, adc_buffer.size() / 2> eval_data{
-		adc_buffer.begin() + (fft_eval_state == fft_eval_state_t::eval_second_half ? adc_buffer.size() / 2 : 0),
+		adc_buffer.begin() + (second_half ? adc_buffer.size() / 2 : 0),
 		adc_buffer.size() / 2,
 	};
 
+	// The host runs the transform on the raw samples itself
+	if (stream_config.encoding == mi::FrameEncoding::RAW
+		|| stream_config.encoding == mi::FrameEncoding::RAW_DELTA)
+	{
+		auto result = sample_encoder.encode(eval_data, stream_config.encoding == mi::FrameEncoding::RAW_DELTA);
+		if (!result.has_value()) return;
+		[[maybe_unused]] auto error = sender.send(result.value());
+		--credits;
+		tx_circ_buf.start_transmission();
+		return;
+	}
+
 	auto fft_result = mi::fft(eval_data, dt);
 	if (!fft_result.has_value()) return;
 
-	mi::FourierData result{fft_result.value()};
-	[[maybe_unused]] auto error = sender.send(result);
+	if (stream_config.encoding == mi::FrameEncoding::DELTA)
+	{
+		auto result = delta_encoder.encode(fft_result.value());
+		if (!result.has_value()) return;
+		[[maybe_unused]] auto error = sender.send(result.value());
+	}
+	else if (stream_config.encoding == mi::FrameEncoding::PACKED)
+	{
+		auto result = bit_packer.pack(fft_result.value(), stream_config.bits);
+		if (!result.has_value()) return;
+		[[maybe_unused]] auto error = sender.send(result.value());
+	}
+	else if (stream_config.batch_size > 1)
+	{
+		auto result = batch_builder.push(fft_result.value());
+		if (!result.has_value()) return;
+		[[maybe_unused]] auto error = sender.send(result.value());
+	}
+	else
+	{
+		mi::FourierData result{fft_result.value()};
+		[[maybe_unused]] auto error = sender.send(result);
+	}
+	--credits;
 	tx_circ_buf.start_transmission();
 }
 
@@ -4,10 +4,7 @@ set -exu
 
 DEVICE=$1
 BUILD_DIR=${2:-build}
+BAUD=${3:-115200}
 
-cat $1 | $BUILD_DIR/recv 2>err.txt | while read line ; do
-    a=`echo $line | $BUILD_DIR/vis -l 20 --max 400`
-    clear
-    echo "$a"
-done
+exec $BUILD_DIR/live -l 20 --max 400 -b $BAUD $DEVICE 2>err.txt
 
@@ -0,0 +1,233 @@
+#define MI_IMPLEMENT
+#include "event_loop.hpp"
+#include "link.hpp"
+#include "spectrum_aligner.hpp"
+#include "spectrum_decoder.hpp"
+#include "spectrum_ring.hpp"
+#include "timer.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <fmt/format.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <vector>
+
+struct
+{
+    uint32_t baud = 115200;
+    uint32_t window = 32;
+    std::string shm = "/mi_spectrum";
+    bool quiet = false;
+    std::vector<const char*> devices;
+} args;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void help(std::string_view program)
+{
+    std::cout << "Example Usage: " << program
+              << " [options] DEVICE...\n"
+                 "Streams from every DEVICE at once and publishes the spectra of the i-th one to\n"
+                 "the shared memory ring <prefix>.i, for vis --shm <prefix>.i and friends. The\n"
+                 "ring <prefix> gets the spectra of all devices lined up in time, one after the\n"
+                 "other in device order. A device silent for a second drops out of it.\n"
+                 "Options:\n"
+                 "  -b, --baud <baud>    Baud rate of the devices\n"
+                 "  -w, --window <n>     Frames each board may send ahead of the host\n"
+                 "  --shm <prefix>       Ring name prefix, /mi_spectrum by default\n"
+                 "  -q, --quiet          No statistics on stderr\n"
+                 "  --help               Display this message\n";
+    exit(EXIT_FAILURE);
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for " << arg << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+        if (arg == "-b" || arg == "--baud")
+            args.baud = std::stoul(value());
+        else if (arg == "-w" || arg == "--window")
+            args.window = std::stoul(value());
+        else if (arg == "--shm")
+            args.shm = value();
+        else if (arg == "-q" || arg == "--quiet")
+            args.quiet = true;
+        else if (!arg.starts_with('-'))
+            args.devices.push_back(argv[i]);
+        else
+            help(argv[0]);
+    }
+    if (args.devices.empty()) help(argv[0]);
+}
+
+struct Device
+{
+    const char* path;
+    std::unique_ptr<mi::Link> link;
+    std::unique_ptr<mi::SpectrumDecoder> decoder;
+    mi::SpectrumRingWriter ring;
+    std::size_t frames = 0;
+    std::size_t errors = 0;
+    bool open = true;
+};
+
+// Serves any number of boards from one thread. Every link is a descriptor in a single epoll loop,
+// so an idle board costs nothing and a busy one only the reads and decodes its own frames need.
+// One timer sends all boards their heartbeat. Spectra are stamped with the steady clock reading
+// of the read that delivered them, and an aligner combines the newest spectrum of every device by
+// that reading into the merged ring, so readers get all devices at once without lining them up.
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    auto loop = mi::EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Wide enough for every device to contribute the widest spectrum the decoder hands out
+    const auto merged_bands =
+        static_cast<uint32_t>(args.devices.size() * mi::SpectrumDecoder::max_bands);
+    auto merged = mi::SpectrumRingWriter::create(args.shm.c_str(), 8, merged_bands);
+    if (!merged.has_value())
+    {
+        std::cerr << "Failed to create " << args.shm << ": " << merged.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    // A board that stops streaming no longer holds up the others after this long
+    mi::SpectrumAligner aligner{args.devices.size(), std::chrono::seconds{1}};
+    std::size_t merged_frames = 0;
+    std::size_t merged_errors = 0;
+    auto on_combined = [&](auto read_at, std::span<const uint8_t> amplitudes)
+    {
+        if (merged->publish(read_at, amplitudes).has_value())
+            ++merged_errors;
+        else
+            ++merged_frames;
+    };
+
+    // Callbacks keep references to their device, so the vector never grows after this
+    std::vector<Device> devices;
+    devices.reserve(args.devices.size());
+    for (const char* path : args.devices)
+    {
+        auto link = mi::Link::open(path, args.baud, args.window);
+        if (!link.has_value())
+        {
+            std::cerr << "Failed to open " << path << ": " << link.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        const std::string name = fmt::format("{}.{}", args.shm, devices.size());
+        auto ring = mi::SpectrumRingWriter::create(name.c_str());
+        if (!ring.has_value())
+        {
+            std::cerr << "Failed to create " << name << ": " << ring.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        devices.push_back(Device{
+            .path = path,
+            .link = std::move(link.value()),
+            .decoder = std::make_unique<mi::SpectrumDecoder>(),
+            .ring = std::move(ring.value()),
+        });
+    }
+
+    std::size_t open_devices = devices.size();
+    for (std::size_t i = 0; i < devices.size(); ++i)
+    {
+        Device& device = devices[i];
+        auto on_spectrum = [&device, &aligner, &on_combined, i](std::span<const uint8_t> amplitudes)
+        {
+            if (device.ring.publish(device.link->last_read(), amplitudes).has_value())
+                ++device.errors;
+            else
+                ++device.frames;
+            aligner.put(i, device.link->last_read(), amplitudes, on_combined);
+        };
+        auto on_message = [&device, on_spectrum](tl::expected<mi::Message, mi::Error> message)
+        {
+            if (!message.has_value() || device.decoder->decode(message.value(), on_spectrum))
+                ++device.errors;
+        };
+        auto on_readable = [&device, &open_devices, &loop, &aligner, on_message, i](uint32_t)
+        {
+            if (device.link->read(on_message)) return;
+            std::cerr << device.path << " closed\n";
+            device.open = false;
+            aligner.close(i);
+            loop->remove(device.link->fd());
+            if (--open_devices == 0) loop->stop();
+        };
+        if (auto error = loop->add(device.link->fd(), EPOLLIN, on_readable))
+        {
+            std::cerr << "Failed to watch " << device.path << ": " << error.value().message()
+                      << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto timer = mi::Timer::create(std::chrono::seconds{1});
+    if (!timer.has_value())
+    {
+        std::cerr << "Failed to create the heartbeat timer: " << timer.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    std::string report;
+    auto on_tick = [&](uint32_t)
+    {
+        if (timer->expirations() == 0) return;
+        report.clear();
+        for (std::size_t i = 0; i < devices.size(); ++i)
+        {
+            Device& device = devices[i];
+            if (!device.open) continue;
+            device.link->heartbeat();
+            fmt::format_to(std::back_inserter(report),
+                           "{}{}: {} frames/s {} errors {} resyncs",
+                           report.empty() ? "" : " | ",
+                           i,
+                           device.frames,
+                           device.errors,
+                           device.link->stats().resyncs);
+            device.frames = 0;
+        }
+        fmt::format_to(std::back_inserter(report),
+                       " | merged: {} frames/s {} errors",
+                       merged_frames,
+                       merged_errors);
+        merged_frames = 0;
+        if (!args.quiet) std::cerr << report << '\n';
+    };
+    if (auto error = loop->add(timer->fd(), EPOLLIN, on_tick))
+    {
+        std::cerr << "Failed to watch the heartbeat timer: " << error.value().message() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // The rings are unlinked on the way out, so stop on a signal rather than die of it
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+    while (!stop_requested && open_devices > 0)
+    {
+        if (auto error = loop->run_once(-1))
+        {
+            std::cerr << "Event loop failed: " << error.value().message() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+}
@@ -0,0 +1,223 @@
+#define MI_IMPLEMENT
+#include "bars.hpp"
+#include "message_definitions.hpp"
+#include "screen.hpp"
+#include "waterfall.hpp"
+
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mi;
+
+namespace
+{
+    // The hand written switch static_type used to be, kept as the baseline
+    auto switch_static_type(message_t& message) -> tl::expected<Message, Error>
+    {
+        switch (message.msg_id)
+        {
+        case Heartbeat::id: return message.payload.deserialize_into<Heartbeat>();
+        case Ack::id: return message.payload.deserialize_into<Ack>();
+        case SetFrequencyData::id: return message.payload.deserialize_into<SetFrequencyData>();
+        case StartStreamingData::id: return message.payload.deserialize_into<StartStreamingData>();
+        case FourierData::id: return message.payload.deserialize_into<FourierData>();
+        case StreamConfig::id: return message.payload.deserialize_into<StreamConfig>();
+        case FourierDelta::id: return message.payload.deserialize_into<FourierDelta>();
+        case PackedFourierData::id:
+            return message.payload.deserialize_into<PackedFourierData>();
+        case FourierBatch::id: return message.payload.deserialize_into<FourierBatch>();
+        default: return tl::unexpected{Error::UNKNOWN_MSG_ID};
+        }
+    }
+
+    struct Payloads
+    {
+        Payloads()
+        {
+            add<Heartbeat>({1});
+            add<Ack>({2, 0, 0});
+            add<SetFrequencyData>({1, 0, 0, 0, 0, 0, 0, 63});
+            add<StartStreamingData>({1, 0, 0, 0});
+            add<FourierData>(std::vector<uint8_t>(256, 7));
+            add<StreamConfig>({1, 32, 6, 1});
+            add<FourierDelta>({0, 1, 2, 0, 9, 9});
+            add<PackedFourierData>({4, 2, 0, 0x21});
+            add<FourierBatch>({2, 1, 0, 5, 6});
+        }
+
+        template<typename Type> void add(std::vector<uint8_t> payload)
+        {
+            storage.push_back(std::move(payload));
+            // Typing only looks at the id and the payload, the CRC was checked before
+            messages.push_back(message_t{
+                .msg_id = Type::id,
+                .payload = {storage.back().data(), storage.back().size()},
+                .crc = 0,
+            });
+        }
+
+        std::vector<std::vector<uint8_t>> storage;
+        std::vector<message_t> messages;
+    };
+
+    // What bars::block did before the glyph table, kept as the baseline: a string per cell
+    auto allocating_block(std::size_t index) -> std::string
+    {
+        index -= 1;
+        if (index > std::numeric_limits<std::size_t>::max() / 2) return " ";
+        index = std::min(index, bars::n_blocks - 1);
+        const static std::string str_blocks{bars::blocks};
+        return str_blocks.substr(index * bars::unicode_size, bars::unicode_size);
+    }
+
+    // A thousand frames of 256 bands drawn on 20 lines, a peak wandering over noise
+    struct Frames
+    {
+        constexpr static std::size_t count = 1000;
+        constexpr static std::size_t columns = 256;
+        constexpr static std::size_t lines = 20;
+
+        Frames()
+        {
+            std::mt19937 rng{7};
+            std::uniform_real_distribution<float> noise{0.F, 3.F};
+            for (std::size_t frame = 0; frame < count; ++frame)
+            {
+                auto& bands = heights.emplace_back(columns);
+                const std::size_t peak = frame % columns;
+                for (std::size_t band = 0; band < columns; ++band)
+                {
+                    const float distance = std::abs(static_cast<float>(band) - peak);
+                    bands[band] = noise(rng) + lines * std::max(0.F, 1.F - distance / 16.F);
+                }
+            }
+        }
+
+        std::vector<std::vector<float>> heights;
+    };
+} // namespace
+
+static void BM_TableStaticType(benchmark::State& state)
+{
+    Payloads payloads;
+    Message out;
+    for (auto _ : state)
+    {
+        for (auto& message : payloads.messages)
+        {
+            auto error = static_type(message, out);
+            benchmark::DoNotOptimize(error);
+            benchmark::DoNotOptimize(out);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * payloads.messages.size());
+}
+BENCHMARK(BM_TableStaticType);
+
+static void BM_SwitchStaticType(benchmark::State& state)
+{
+    Payloads payloads;
+    for (auto _ : state)
+    {
+        for (auto& message : payloads.messages)
+        {
+            auto typed = switch_static_type(message);
+            benchmark::DoNotOptimize(typed);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * payloads.messages.size());
+}
+BENCHMARK(BM_SwitchStaticType);
+
+static void BM_RenderBarsAllocating(benchmark::State& state)
+{
+    Frames frames;
+    std::string out;
+    for (auto _ : state)
+    {
+        for (const auto& heights : frames.heights)
+        {
+            out.clear();
+            for (std::size_t line = Frames::lines; line != 0; --line)
+            {
+                for (auto f : heights)
+                {
+                    const float eighths = (f - line + 1) * bars::n_blocks;
+                    out += allocating_block(static_cast<std::size_t>(std::max(eighths, 0.F)));
+                }
+                out += '\n';
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * Frames::count);
+}
+BENCHMARK(BM_RenderBarsAllocating);
+
+static void BM_RenderBars(benchmark::State& state)
+{
+    Frames frames;
+    std::string out;
+    for (auto _ : state)
+    {
+        for (const auto& heights : frames.heights)
+        {
+            out.clear();
+            render_bars(heights, Frames::lines, out);
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * Frames::count);
+}
+BENCHMARK(BM_RenderBars);
+
+// Through the diff renderer, bytes/s being what the terminal would be sent
+static void BM_RenderScreen(benchmark::State& state)
+{
+    Frames frames;
+    Screen screen;
+    std::string out;
+    std::size_t written = 0;
+    for (auto _ : state)
+    {
+        for (const auto& heights : frames.heights)
+        {
+            screen.clear(Frames::lines, Frames::columns);
+            render_bars(heights, Frames::lines, screen);
+            out.clear();
+            screen.flush(out);
+            written += out.size();
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * Frames::count);
+    state.SetBytesProcessed(written);
+}
+BENCHMARK(BM_RenderScreen);
+
+// Every frame scrolls in as a new row, or with `redraw` the whole history is written again
+static void BM_Waterfall(benchmark::State& state)
+{
+    const bool redraw = state.range(0) != 0;
+    Frames frames;
+    Waterfall waterfall{Frames::lines};
+    std::string out;
+    std::size_t written = 0;
+    for (auto _ : state)
+    {
+        for (const auto& heights : frames.heights)
+        {
+            waterfall.push(heights, Frames::lines);
+            if (redraw) waterfall.invalidate();
+            out.clear();
+            waterfall.draw(0, out);
+            written += out.size();
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * Frames::count);
+    state.SetBytesProcessed(written);
+}
+BENCHMARK(BM_Waterfall)->ArgName("redraw")->Arg(0)->Arg(1);
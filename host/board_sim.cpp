@@ -0,0 +1,314 @@
+#define MI_IMPLEMENT
+#include "event_loop.hpp"
+#include "signal_source.hpp"
+#include "simulated_board.hpp"
+#include "timer.hpp"
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+using Clock = mi::SimulatedBoard::Clock;
+
+struct
+{
+    uint32_t baud = 115200;
+    float rate = 10'000.F;
+    std::vector<mi::SignalSource::Tone> tones;
+    std::optional<mi::SignalSource::Sweep> sweep;
+    float noise = 0.F;
+    const char* wav = nullptr;
+    const char* link = nullptr;
+    bool quiet = false;
+} args;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void help(std::string_view program)
+{
+    std::cout << "Example Usage: " << program
+              << " [options]\n"
+                 "Plays the board on a pseudo-terminal, for the host tools to talk to without\n"
+                 "hardware. Prints the terminal's path, then streams like the firmware would.\n"
+                 "Without a signal option it samples a 1 kHz tone.\n"
+                 "Options:\n"
+                 "  -b, --baud <baud>        Line rate the output is paced at\n"
+                 "  --rate <hz>              ADC sample rate, 10000 like the board by default\n"
+                 "  --tone <hz>[:<level>]    Adds a sine, level relative to full scale\n"
+                 "  --sweep <from>:<to>:<s>  Adds a sine gliding from one frequency to another\n"
+                 "  --noise <level>          Adds white noise\n"
+                 "  --wav <file>             Samples a WAV file in a loop, at its own rate\n"
+                 "  --link <path>            Symlinks the terminal to a fixed path\n"
+                 "  -q, --quiet              No statistics on stderr\n"
+                 "  --help                   Display this message\n";
+    exit(EXIT_FAILURE);
+}
+
+// Splits "a:b:c" into up to `fields` floats, returns how many were given
+auto parse_fields(std::string_view text, std::span<float> fields) -> std::size_t
+{
+    std::size_t count = 0;
+    while (count < fields.size())
+    {
+        const auto colon = text.find(':');
+        fields[count++] = std::stof(std::string{text.substr(0, colon)});
+        if (colon == std::string_view::npos) break;
+        text.remove_prefix(colon + 1);
+    }
+    return count;
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for " << arg << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+        if (arg == "-b" || arg == "--baud")
+            args.baud = std::stoul(value());
+        else if (arg == "--rate")
+            args.rate = std::stof(value());
+        else if (arg == "--tone")
+        {
+            std::array<float, 2> fields{0.F, mi::SignalSource::Tone{}.level};
+            (void)parse_fields(value(), fields);
+            args.tones.push_back({.frequency = fields[0], .level = fields[1]});
+        }
+        else if (arg == "--sweep")
+        {
+            std::array<float, 4> fields{0.F, 0.F, 0.F, mi::SignalSource::Sweep{}.level};
+            if (parse_fields(value(), fields) < 3) help(argv[0]);
+            args.sweep = {fields[0], fields[1], fields[2], fields[3]};
+        }
+        else if (arg == "--noise")
+            args.noise = std::stof(value());
+        else if (arg == "--wav")
+            args.wav = value();
+        else if (arg == "--link")
+            args.link = value();
+        else if (arg == "-q" || arg == "--quiet")
+            args.quiet = true;
+        else
+            help(argv[0]);
+    }
+    if (args.baud == 0 || args.rate <= 0.F) help(argv[0]);
+    if (args.wav == nullptr && args.tones.empty() && !args.sweep && args.noise <= 0.F)
+        args.tones.push_back({.frequency = 1000.F});
+}
+
+// Opens a pseudo-terminal pair and returns the controlling side. The terminal side stays open
+// as well, so the host may close and reopen it without the controller seeing a hang up.
+auto open_terminal(int& terminal) -> int
+{
+    const int controller = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (controller < 0) return -1;
+    if (grantpt(controller) < 0 || unlockpt(controller) < 0
+        || fcntl(controller, F_SETFL, fcntl(controller, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        close(controller);
+        return -1;
+    }
+    terminal = open(ptsname(controller), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (terminal < 0)
+    {
+        close(controller);
+        return -1;
+    }
+    // Raw right away, so even a host that never configures the terminal gets the bytes unchanged
+    termios tty{};
+    if (tcgetattr(terminal, &tty) == 0)
+    {
+        cfmakeraw(&tty);
+        tcsetattr(terminal, TCSANOW, &tty);
+    }
+    return controller;
+}
+
+// Runs the firmware's loop against a synthetic ADC. The ADC timer fills half the DMA buffer at
+// the sample rate, and every block is transformed and encoded like on the board. The UART is
+// modelled as a line that carries one byte every 10 bit times: bytes are written in bursts of a
+// millisecond's worth, the next burst waiting until the line would be free. A block that comes
+// in while the previous frame is still going out is skipped, as the board's main loop would be
+// stuck pushing into its transmit buffer and miss that ADC interrupt.
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    mi::SignalSource source{args.rate};
+    if (args.wav != nullptr)
+    {
+        auto wav = mi::SignalSource::open_wav(args.wav);
+        if (!wav.has_value())
+        {
+            std::cerr << "Failed to open " << args.wav << ": " << wav.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        source = std::move(wav.value());
+    }
+    source.tones = args.tones;
+    source.sweep = args.sweep;
+    source.noise = args.noise;
+
+    auto loop = mi::EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    int terminal = -1;
+    const int controller = open_terminal(terminal);
+    if (controller < 0)
+    {
+        std::cerr << "Failed to open a pseudo-terminal: " << std::strerror(errno) << '\n';
+        return EXIT_FAILURE;
+    }
+    const char* path = ptsname(controller);
+    if (args.link != nullptr)
+    {
+        unlink(args.link);
+        if (symlink(path, args.link) < 0)
+        {
+            std::cerr << "Failed to link " << args.link << ": " << std::strerror(errno) << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << path << std::endl;
+
+    mi::SimulatedBoard board;
+    std::array<uint16_t, mi::SimulatedBoard::block_size> block;
+    const float dt = static_cast<float>(block.size()) / source.sample_rate();
+    const std::chrono::nanoseconds byte_time{10'000'000'000ULL / args.baud};
+    const std::size_t burst = std::max<std::size_t>(args.baud / 10'000, 1);
+
+    auto adc = mi::Timer::create(std::chrono::nanoseconds{
+        static_cast<int64_t>(static_cast<double>(dt) * 1e9)});
+    auto uart = mi::Timer::create(Clock::duration::zero());
+    auto report = mi::Timer::create(std::chrono::seconds{1});
+    for (auto* timer : {&adc, &uart, &report})
+    {
+        if (timer->has_value()) continue;
+        std::cerr << "Failed to create a timer: " << timer->error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Bytes of the board's outbound buffer already on the line
+    std::size_t sent = 0;
+    Clock::time_point line_free;
+    std::size_t frames = 0;
+    std::size_t skipped = 0;
+    std::size_t bytes = 0;
+    auto transmit = [&]()
+    {
+        std::vector<uint8_t>& pending = board.outbound();
+        const auto now = Clock::now();
+        if (sent == pending.size() || now < line_free) return;
+        const std::size_t size = std::min(pending.size() - sent, burst);
+        const ssize_t written = write(controller, pending.data() + sent, size);
+        // A host that doesn't read fills the terminal's buffer, try again a burst later
+        const std::size_t taken = written > 0 ? static_cast<std::size_t>(written) : 0;
+        sent += taken;
+        bytes += taken;
+        line_free = now + byte_time * (taken > 0 ? taken : burst);
+        if (sent == pending.size())
+        {
+            pending.clear();
+            sent = 0;
+        }
+        (void)uart->schedule(line_free - now);
+    };
+
+    auto on_adc = [&](uint32_t)
+    {
+        for (uint64_t expired = adc->expirations(); expired > 0; --expired)
+        {
+            source.fill(block);
+            const auto now = Clock::now();
+            if (sent < board.outbound().size())
+            {
+                if (board.listening(now) && board.credits() > 0) ++skipped;
+                continue;
+            }
+            frames += board.sample(block, dt, now);
+        }
+        transmit();
+    };
+    std::array<uint8_t, 256> input;
+    auto on_host = [&](uint32_t)
+    {
+        const ssize_t len = read(controller, input.data(), input.size());
+        if (len <= 0) return;
+        board.receive({input.data(), static_cast<std::size_t>(len)}, Clock::now());
+        // Error bytes go out right away
+        transmit();
+    };
+    auto on_uart = [&](uint32_t)
+    {
+        if (uart->expirations() > 0) transmit();
+    };
+    auto on_report = [&](uint32_t)
+    {
+        if (report->expirations() == 0 || args.quiet) return;
+        std::cerr << fmt::format("{} frames/s {} skipped {} B/s {} credits{}\n",
+                                 frames,
+                                 skipped,
+                                 bytes,
+                                 board.credits(),
+                                 board.listening(Clock::now()) ? "" : " (no heartbeat)");
+        frames = 0;
+        skipped = 0;
+        bytes = 0;
+    };
+    const std::array<std::pair<int, mi::EventLoop::Callback>, 4> watched{{
+        {controller, on_host},
+        {adc->fd(), on_adc},
+        {uart->fd(), on_uart},
+        {report->fd(), on_report},
+    }};
+    for (const auto& [fd, callback] : watched)
+    {
+        if (auto error = loop->add(fd, EPOLLIN, callback))
+        {
+            std::cerr << "Failed to watch descriptor " << fd << ": " << error.value().message()
+                      << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The link is removed on the way out, so stop on a signal rather than die of it
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+    int status = EXIT_SUCCESS;
+    while (!stop_requested)
+    {
+        if (auto error = loop->run_once(-1))
+        {
+            std::cerr << "Event loop failed: " << error.value().message() << '\n';
+            status = EXIT_FAILURE;
+            break;
+        }
+    }
+    if (args.link != nullptr) unlink(args.link);
+    close(terminal);
+    close(controller);
+    return status;
+}
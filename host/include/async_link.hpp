@@ -0,0 +1,236 @@
+#pragma once
+
+#include "session.hpp"
+#include "task.hpp"
+#include "timer.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <list>
+#include <memory>
+#include <optional>
+#include <variant>
+
+namespace mi
+{
+    // Awaitable face of a Session, so a board's conversation can be written as straight line
+    // code and any number of boards can be talked to from one thread:
+    //
+    //     auto config = co_await link->request<Ack>(StreamConfig{...});
+    //     while (auto data = co_await link->next<FourierData>()) ...
+    //
+    // Coroutines waiting on a link are resumed from its event loop. A message that views the
+    // link's buffers, FourierData for one, stays valid until its coroutine suspends again.
+    // Frames nobody waits for are dropped, and the link must outlive the coroutines using it.
+    struct AsyncLink
+    {
+        using Clock = Link::Clock;
+        template<typename T> struct NextAwaiter;
+
+        [[nodiscard]] static auto open(EventLoop& loop,
+                                       const char* device,
+                                       uint32_t baud,
+                                       uint32_t window)
+            -> tl::expected<std::unique_ptr<AsyncLink>, std::error_code>;
+
+        AsyncLink(const AsyncLink&) = delete;
+        auto operator=(const AsyncLink&) -> AsyncLink& = delete;
+        ~AsyncLink();
+
+        // Completes without waiting, a message fits a single write the tty takes right away
+        template<std::convertible_to<Message> ConcreteMessage>
+        [[nodiscard]] auto send(ConcreteMessage message) -> Task<std::optional<Error>>;
+        // The next T the board sends, TIMED_OUT once `timeout` passes without one and
+        // LINK_CLOSED if the device goes away first
+        template<typename T>
+        [[nodiscard]] auto next(std::optional<Clock::duration> timeout = std::nullopt)
+            -> NextAwaiter<T>;
+        // Sends `message` and waits for the Reply to it. An Ack only counts if it acknowledges
+        // the request's message id, and a negative one turns into its error.
+        template<typename Reply, std::convertible_to<Message> Request>
+        [[nodiscard]] auto request(Request message, Clock::duration timeout)
+            -> Task<tl::expected<Reply, Error>>;
+
+        [[nodiscard]] auto stats() const -> const ReceiverStats& { return session->stats(); }
+
+    private:
+        struct Waiter
+        {
+            uint16_t id;
+            std::coroutine_handle<> handle;
+            std::optional<tl::expected<Message, Error>>* result;
+            std::optional<Clock::time_point> deadline;
+        };
+
+        explicit AsyncLink(EventLoop& loop_) : loop{loop_} {}
+        void wait(Waiter waiter);
+        void dispatch(tl::expected<Message, Error> message);
+        void expire();
+        void close();
+        // Resumes the waiters, which may start waiting again on the spot
+        static void resume(std::list<Waiter>& ready, const tl::expected<Message, Error>& result);
+        void schedule_timeout();
+
+        EventLoop& loop;
+        std::unique_ptr<Session> session;
+        std::unique_ptr<Timer> timeout;
+        std::list<Waiter> waiters;
+        bool closed = false;
+    };
+
+    template<typename T> struct AsyncLink::NextAwaiter
+    {
+        [[nodiscard]] auto await_ready() const -> bool { return link.closed; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            link.wait({.id = T::id, .handle = handle, .result = &result, .deadline = deadline});
+        }
+        auto await_resume() -> tl::expected<T, Error>
+        {
+            if (!result.has_value()) return tl::unexpected{Error::LINK_CLOSED};
+            if (!result->has_value()) return tl::unexpected{result->error()};
+            return std::get<T>(result->value());
+        }
+
+        AsyncLink& link;
+        std::optional<Clock::time_point> deadline;
+        std::optional<tl::expected<Message, Error>> result;
+    };
+
+    template<std::convertible_to<Message> ConcreteMessage>
+    auto AsyncLink::send(ConcreteMessage message) -> Task<std::optional<Error>>
+    {
+        if (closed) co_return Error::LINK_CLOSED;
+        co_return session->send(message);
+    }
+
+    template<typename T>
+    auto AsyncLink::next(std::optional<Clock::duration> timeout) -> NextAwaiter<T>
+    {
+        std::optional<Clock::time_point> deadline;
+        if (timeout) deadline = Clock::now() + *timeout;
+        return NextAwaiter<T>{*this, deadline, std::nullopt};
+    }
+
+    template<typename Reply, std::convertible_to<Message> Request>
+    auto AsyncLink::request(Request message, Clock::duration timeout)
+        -> Task<tl::expected<Reply, Error>>
+    {
+        if (auto error = co_await send(message)) co_return tl::unexpected{error.value()};
+        const auto deadline = Clock::now() + timeout;
+        while (true)
+        {
+            auto reply = co_await next<Reply>(deadline - Clock::now());
+            if constexpr (std::same_as<Reply, Ack>)
+            {
+                if (reply && reply->msg_id != Request::id) continue;
+                if (reply && reply->error != Error::NO_ERROR)
+                    co_return tl::unexpected{reply->error};
+            }
+            co_return reply;
+        }
+    }
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <sys/epoll.h>
+
+namespace mi
+{
+    auto AsyncLink::open(EventLoop& loop, const char* device, uint32_t baud, uint32_t window)
+        -> tl::expected<std::unique_ptr<AsyncLink>, std::error_code>
+    {
+        std::unique_ptr<AsyncLink> link{new AsyncLink{loop}};
+        AsyncLink& self = *link;
+        auto timer = Timer::create(Clock::duration::zero());
+        if (!timer.has_value()) return tl::unexpected{timer.error()};
+        self.timeout = std::make_unique<Timer>(std::move(timer.value()));
+        auto on_timeout = [&self](uint32_t)
+        {
+            if (self.timeout->expirations() > 0) self.expire();
+        };
+        if (auto error = loop.add(self.timeout->fd(), EPOLLIN, on_timeout))
+            return tl::unexpected{error.value()};
+
+        auto session = Session::open(
+            loop,
+            device,
+            baud,
+            window,
+            [&self](tl::expected<Message, Error> message) { self.dispatch(message); },
+            [&self]() { self.close(); });
+        if (!session.has_value()) return tl::unexpected{session.error()};
+        self.session = std::move(session.value());
+        return link;
+    }
+
+    AsyncLink::~AsyncLink()
+    {
+        if (timeout) loop.remove(timeout->fd());
+    }
+
+    void AsyncLink::wait(Waiter waiter)
+    {
+        waiters.push_back(waiter);
+        if (waiter.deadline) schedule_timeout();
+    }
+
+    void AsyncLink::dispatch(tl::expected<Message, Error> message)
+    {
+        // Frames that failed to decode can't be told apart, their errors only show in the stats
+        if (!message.has_value()) return;
+        const uint16_t id = std::visit([](const auto& m) { return m.id; }, message.value());
+        std::list<Waiter> ready;
+        for (auto waiter = waiters.begin(); waiter != waiters.end();)
+        {
+            auto current = waiter++;
+            if (current->id == id) ready.splice(ready.end(), waiters, current);
+        }
+        resume(ready, message);
+    }
+
+    void AsyncLink::expire()
+    {
+        const auto now = Clock::now();
+        std::list<Waiter> expired;
+        for (auto waiter = waiters.begin(); waiter != waiters.end();)
+        {
+            auto current = waiter++;
+            if (current->deadline && *current->deadline <= now)
+                expired.splice(expired.end(), waiters, current);
+        }
+        resume(expired, tl::unexpected{Error::TIMED_OUT});
+        schedule_timeout();
+    }
+
+    void AsyncLink::close()
+    {
+        closed = true;
+        std::list<Waiter> all;
+        all.swap(waiters);
+        resume(all, tl::unexpected{Error::LINK_CLOSED});
+    }
+
+    void AsyncLink::resume(std::list<Waiter>& ready, const tl::expected<Message, Error>& result)
+    {
+        for (Waiter& waiter : ready)
+            *waiter.result = result;
+        for (Waiter& waiter : ready)
+            waiter.handle.resume();
+    }
+
+    void AsyncLink::schedule_timeout()
+    {
+        std::optional<Clock::time_point> earliest;
+        for (const Waiter& waiter : waiters)
+        {
+            if (waiter.deadline && (!earliest || *waiter.deadline < *earliest))
+                earliest = waiter.deadline;
+        }
+        // A deadline already passed still needs the timer to fire, and 0 would disarm it
+        const auto delay = earliest ? std::max(*earliest - Clock::now(), Clock::duration{1})
+                                    : Clock::duration::zero();
+        [[maybe_unused]] auto error = timeout->schedule(delay);
+    }
+} // namespace mi
+#endif
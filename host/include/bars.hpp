@@ -0,0 +1,111 @@
+#pragma once
+
+#include "screen.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mi
+{
+    struct ScaleOptions
+    {
+        std::size_t lines = 1;
+        float max = std::numeric_limits<float>::infinity();
+        float min = std::numeric_limits<float>::lowest();
+    };
+
+    // Values under `min` drop to zero, then everything is divided by `max`, or by the largest
+    // value when there is no `max`, and stretched over `lines`
+    template<typename Value>
+    void scale(std::span<const Value> values,
+               const ScaleOptions& options,
+               std::vector<float>& heights)
+    {
+        heights.clear();
+        float max = std::numeric_limits<float>::lowest();
+        for (auto value : values)
+        {
+            auto f = static_cast<float>(value);
+            if (f < options.min) f = 0;
+            max = std::max(max, f);
+            heights.push_back(f);
+        }
+        for (auto& f : heights)
+        {
+            f /= std::isfinite(options.max) ? options.max : max;
+            f *= options.lines;
+        }
+    }
+
+    namespace bars
+    {
+        constexpr std::string_view blocks = "▁▂▃▄▅▆▇█";
+        constexpr std::size_t unicode_size = sizeof("▂") - sizeof('\0');
+        constexpr std::size_t n_blocks = blocks.size() / unicode_size;
+
+        // Every glyph a cell can show as fixed bytes, the blank cell first and then a block per
+        // eighth, so drawing a cell is a lookup and a copy that never builds a string
+        constexpr auto glyphs = []()
+        {
+            std::array<Screen::Cell, n_blocks + 1> table{};
+            for (std::size_t i = 0; i < n_blocks; ++i)
+            {
+                const auto bytes = blocks.substr(i * unicode_size, unicode_size);
+                std::ranges::copy(bytes, table[i + 1].bytes.begin());
+                table[i + 1].size = unicode_size;
+            }
+            return table;
+        }();
+
+        // Glyph of a cell filled `eighths` eighths from the bottom, blank up to 0 and full from 8
+        constexpr auto glyph(float eighths) -> const Screen::Cell&
+        {
+            if (!(eighths >= 1.F)) return glyphs[0];
+            const float filled = std::min(eighths, static_cast<float>(n_blocks));
+            return glyphs[static_cast<std::size_t>(filled)];
+        }
+    } // namespace bars
+
+    // Appends `lines` rows of block glyphs to `out`, top row first, every row ended by a newline.
+    // Reusing `out` from frame to frame, a frame allocates nothing once it has grown to size.
+    inline void render_bars(std::span<const float> heights, std::size_t lines, std::string& out)
+    {
+        constexpr std::size_t max_glyph_size = sizeof(Screen::Cell::bytes);
+        const std::size_t start = out.size();
+        out.resize(start + lines * (heights.size() * max_glyph_size + 1));
+        // Whole glyph slots are copied, the next glyph overwrites whatever the last one didn't use
+        char* cursor = out.data() + start;
+        for (std::size_t line = lines; line != 0; --line)
+        {
+            for (auto f : heights)
+            {
+                const Screen::Cell& cell = bars::glyph((f - line + 1) * bars::n_blocks);
+                std::memcpy(cursor, cell.bytes.data(), max_glyph_size);
+                cursor += cell.size;
+            }
+            *cursor++ = '\n';
+        }
+        out.resize(cursor - out.data());
+    }
+
+    // Draws the same rows into the top `lines` rows of `screen`, a column per height
+    inline void render_bars(std::span<const float> heights, std::size_t lines, Screen& screen)
+    {
+        for (std::size_t row = 0; row < lines; ++row)
+        {
+            const std::size_t line = lines - row;
+            for (std::size_t column = 0; column < heights.size(); ++column)
+            {
+                const float eighths = (heights[column] - line + 1) * bars::n_blocks;
+                screen.put(row, column, bars::glyph(eighths));
+            }
+        }
+    }
+} // namespace mi
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "message_definitions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace mi
+{
+    // Amplitudes keep their `bits` most significant bits and are packed LSB first, eight at a
+    // time into a 64 bit word, which then gets stored as `bits` little endian bytes. The width is
+    // a template parameter of the inner loops so the shifts are constants the compiler can unroll
+    // and vectorize, the runtime width only picks the instantiation.
+    namespace bitpack
+    {
+        constexpr static uint8_t min_bits = 4;
+        constexpr static uint8_t max_bits = 8;
+        constexpr static std::size_t group = 8;
+
+        [[nodiscard]] constexpr auto packed_size(std::size_t bands, uint8_t bits) -> std::size_t
+        {
+            return (bands * bits + UINT8_WIDTH - 1) / UINT8_WIDTH;
+        }
+
+        // Replicates the top bits into the bottom ones so that full scale stays full scale
+        template<uint8_t Bits> [[nodiscard]] constexpr auto widen(uint8_t value) -> uint8_t
+        {
+            return (value << (UINT8_WIDTH - Bits)) | (value >> (2 * Bits - UINT8_WIDTH));
+        }
+
+        template<uint8_t Bits>
+        void pack_groups(const uint8_t* in, std::size_t groups, uint8_t* out)
+        {
+            for (std::size_t g = 0; g < groups; ++g)
+            {
+                uint64_t word = 0;
+                for (std::size_t j = 0; j < group; ++j)
+                {
+                    word |= static_cast<uint64_t>(in[g * group + j] >> (UINT8_WIDTH - Bits))
+                            << (j * Bits);
+                }
+                std::memcpy(out + g * Bits, &word, Bits);
+            }
+        }
+
+        template<uint8_t Bits>
+        void unpack_groups(const uint8_t* in, std::size_t groups, uint8_t* out)
+        {
+            constexpr uint64_t mask = (1U << Bits) - 1;
+            for (std::size_t g = 0; g < groups; ++g)
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, in + g * Bits, Bits);
+                for (std::size_t j = 0; j < group; ++j)
+                {
+                    out[g * group + j] = widen<Bits>((word >> (j * Bits)) & mask);
+                }
+            }
+        }
+
+        template<uint8_t Bits>
+        void pack(std::span<const uint8_t> amplitudes, uint8_t* out)
+        {
+            const std::size_t full = amplitudes.size() / group;
+            pack_groups<Bits>(amplitudes.data(), full, out);
+            if (amplitudes.size() % group == 0) return;
+
+            std::array<uint8_t, group> tail{};
+            std::array<uint8_t, Bits> packed_tail;
+            std::copy(amplitudes.begin() + full * group, amplitudes.end(), tail.begin());
+            pack_groups<Bits>(tail.data(), 1, packed_tail.data());
+            std::copy_n(packed_tail.begin(),
+                        packed_size(amplitudes.size(), Bits) - full * Bits,
+                        out + full * Bits);
+        }
+
+        template<uint8_t Bits>
+        void unpack(std::span<const uint8_t> packed, std::size_t bands, uint8_t* out)
+        {
+            const std::size_t full = bands / group;
+            unpack_groups<Bits>(packed.data(), full, out);
+            if (bands % group == 0) return;
+
+            std::array<uint8_t, Bits> packed_tail{};
+            std::array<uint8_t, group> tail;
+            std::copy(packed.begin() + full * Bits, packed.end(), packed_tail.begin());
+            unpack_groups<Bits>(packed_tail.data(), 1, tail.data());
+            std::copy_n(tail.begin(), bands - full * group, out + full * group);
+        }
+
+        template<typename Function> auto with_bits(uint8_t bits, Function&& function) -> bool
+        {
+            switch (bits)
+            {
+            case 4: function.template operator()<4>(); return true;
+            case 5: function.template operator()<5>(); return true;
+            case 6: function.template operator()<6>(); return true;
+            case 7: function.template operator()<7>(); return true;
+            case 8: function.template operator()<8>(); return true;
+            default: return false;
+            }
+        }
+    } // namespace bitpack
+
+    template<std::size_t MaxBands> struct BitPacker
+    {
+        // The returned frame views the packer's buffer and is valid until the next call
+        [[nodiscard]] auto pack(std::span<const uint8_t> amplitudes, uint8_t bits)
+            -> tl::expected<PackedFourierData, Error>;
+
+    private:
+        std::array<uint8_t, PackedFourierData::header_size + MaxBands> buffer;
+    };
+
+    template<std::size_t MaxBands>
+    auto BitPacker<MaxBands>::pack(std::span<const uint8_t> amplitudes, uint8_t bits)
+        -> tl::expected<PackedFourierData, Error>
+    {
+        if (amplitudes.size() > MaxBands) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        uint8_t* out = buffer.begin() + PackedFourierData::header_size;
+        const bool supported = bitpack::with_bits(
+            bits, [&amplitudes, out]<uint8_t Bits>() { bitpack::pack<Bits>(amplitudes, out); });
+        if (!supported) return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+
+        buffer[0] = bits;
+        buffer[1] = amplitudes.size() & UINT8_MAX;
+        buffer[2] = amplitudes.size() >> UINT8_WIDTH;
+        return PackedFourierData{{
+            buffer.begin(),
+            PackedFourierData::header_size + bitpack::packed_size(amplitudes.size(), bits),
+        }};
+    }
+
+    template<std::size_t MaxBands> struct BitUnpacker
+    {
+        // The returned amplitudes view the unpacker's buffer and are valid until the next call
+        [[nodiscard]] auto unpack(const PackedFourierData& data)
+            -> tl::expected<std::span<uint8_t>, Error>;
+
+    private:
+        std::array<uint8_t, MaxBands> amplitudes;
+    };
+
+    template<std::size_t MaxBands>
+    auto BitUnpacker<MaxBands>::unpack(const PackedFourierData& data)
+        -> tl::expected<std::span<uint8_t>, Error>
+    {
+        if (data.bands() > MaxBands) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        const bool supported = bitpack::with_bits(
+            data.bits(),
+            [&data, this]<uint8_t Bits>()
+            { bitpack::unpack<Bits>(data.packed(), data.bands(), amplitudes.data()); });
+        if (!supported) return tl::unexpected{Error::INCORRECT_ALIGNMENT};
+
+        return std::span<uint8_t>{amplitudes.begin(), data.bands()};
+    }
+} // namespace mi
@@ -0,0 +1,369 @@
+#pragma once
+
+#include "mapping.hpp"
+#include "tl-expected.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace mi
+{
+    // Capture files keep what a link delivered, to replay it without a board. A FileHeader is
+    // followed by entries, each an EntryHeader and its payload: the bytes of one read off the
+    // link, or one decoded spectrum. The file is only ever appended to. Closing it appends one
+    // more entry holding a sparse index, a point every `index_stride` entries, and a Trailer
+    // locating that entry. A file cut short by a crash has neither, the reader then scans it and
+    // keeps every entry up to the last complete one.
+    namespace capture
+    {
+        // "MICAP1" and "MICAPIDX" as little endian words
+        constexpr static uint64_t magic = 0x3150'4143'494D;
+        constexpr static uint64_t trailer_magic = 0x5844'4950'4143'494D;
+        constexpr static uint32_t version = 1;
+        constexpr static std::size_t index_stride = 256;
+
+        enum struct Kind : uint8_t
+        {
+            LINK_BYTES,
+            SPECTRUM,
+            INDEX,
+        };
+
+#pragma pack(push, 1)
+        struct FileHeader
+        {
+            uint64_t magic;
+            uint32_t version;
+        };
+
+        struct EntryHeader
+        {
+            uint64_t timestamp_ns; // Steady clock reading of the read that delivered the payload
+            uint32_t size;
+            Kind kind;
+        };
+
+        struct IndexPoint
+        {
+            uint64_t timestamp_ns;
+            uint64_t offset;
+        };
+
+        struct Trailer
+        {
+            uint64_t index_offset;
+            uint64_t magic;
+        };
+#pragma pack(pop)
+    } // namespace capture
+
+    struct CaptureEntry
+    {
+        capture::Kind kind;
+        std::chrono::steady_clock::time_point timestamp;
+        std::span<const uint8_t> payload;
+    };
+
+    struct CaptureWriter
+    {
+        // Truncates whatever is at `path`
+        [[nodiscard]] static auto create(const char* path)
+            -> tl::expected<CaptureWriter, std::error_code>;
+
+        CaptureWriter(CaptureWriter&& other) noexcept;
+        auto operator=(CaptureWriter&& other) noexcept -> CaptureWriter&;
+        CaptureWriter(const CaptureWriter&) = delete;
+        auto operator=(const CaptureWriter&) -> CaptureWriter& = delete;
+        // Finishes the file if nobody did
+        ~CaptureWriter();
+
+        [[nodiscard]] auto append(capture::Kind kind,
+                                  std::chrono::steady_clock::time_point timestamp,
+                                  std::span<const uint8_t> payload)
+            -> std::optional<std::error_code>;
+        // Writes out the buffered entries, the index and the trailer and closes the file
+        [[nodiscard]] auto finish() -> std::optional<std::error_code>;
+
+    private:
+        explicit CaptureWriter(int descriptor_);
+        [[nodiscard]] auto put(capture::Kind kind,
+                               uint64_t timestamp_ns,
+                               std::span<const uint8_t> payload) -> std::optional<std::error_code>;
+        [[nodiscard]] auto flush() -> std::optional<std::error_code>;
+
+        int descriptor;
+        uint64_t offset = sizeof(capture::FileHeader);
+        uint64_t entries = 0;
+        std::vector<uint8_t> buffer;
+        std::vector<capture::IndexPoint> index;
+    };
+
+    struct CaptureReader
+    {
+        [[nodiscard]] static auto open(const char* path)
+            -> tl::expected<CaptureReader, std::error_code>;
+
+        // Offset of the first entry
+        [[nodiscard]] auto begin() const -> std::size_t { return sizeof(capture::FileHeader); }
+        // Offset of the first entry at or after `timestamp`. The index narrows the search down to
+        // `index_stride` entries.
+        [[nodiscard]] auto seek(std::chrono::steady_clock::time_point timestamp) const
+            -> std::size_t;
+        // The entry at `offset`, which then moves on to the next one. Empty past the last entry.
+        [[nodiscard]] auto next(std::size_t& offset) const -> std::optional<CaptureEntry>;
+
+    private:
+        CaptureReader(Mapping memory_, std::size_t end_) : memory{std::move(memory_)}, end{end_} {}
+        void load_index();
+        [[nodiscard]] auto entry_at(std::size_t offset) const -> std::optional<CaptureEntry>;
+
+        Mapping memory;
+        std::size_t end;
+        std::vector<capture::IndexPoint> index;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <algorithm>
+#    include <cerrno>
+#    include <cstring>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#    include <utility>
+
+namespace mi
+{
+    namespace
+    {
+        // Entries pile up in memory until there is this much to write in one go
+        constexpr std::size_t capture_flush_size = 1 << 16;
+
+        auto to_ns(std::chrono::steady_clock::time_point timestamp) -> uint64_t
+        {
+            return static_cast<uint64_t>(
+                std::chrono::nanoseconds{timestamp.time_since_epoch()}.count());
+        }
+
+        auto as_bytes(const auto& value) -> std::span<const uint8_t>
+        {
+            return {reinterpret_cast<const uint8_t*>(&value), sizeof(value)};
+        }
+    } // namespace
+
+    auto CaptureWriter::create(const char* path) -> tl::expected<CaptureWriter, std::error_code>
+    {
+        const int descriptor = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (descriptor < 0) return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        CaptureWriter writer{descriptor};
+        const capture::FileHeader header{.magic = capture::magic, .version = capture::version};
+        writer.buffer.insert(writer.buffer.end(), as_bytes(header).begin(), as_bytes(header).end());
+        return writer;
+    }
+
+    CaptureWriter::CaptureWriter(int descriptor_) : descriptor{descriptor_}
+    {
+        buffer.reserve(2 * capture_flush_size);
+    }
+
+    CaptureWriter::CaptureWriter(CaptureWriter&& other) noexcept :
+        descriptor{std::exchange(other.descriptor, -1)},
+        offset{other.offset},
+        entries{other.entries},
+        buffer{std::move(other.buffer)},
+        index{std::move(other.index)}
+    {
+    }
+
+    auto CaptureWriter::operator=(CaptureWriter&& other) noexcept -> CaptureWriter&
+    {
+        std::swap(descriptor, other.descriptor);
+        std::swap(offset, other.offset);
+        std::swap(entries, other.entries);
+        std::swap(buffer, other.buffer);
+        std::swap(index, other.index);
+        return *this;
+    }
+
+    CaptureWriter::~CaptureWriter()
+    {
+        if (descriptor >= 0)
+        {
+            [[maybe_unused]] auto error = finish();
+        }
+    }
+
+    auto CaptureWriter::append(capture::Kind kind,
+                               std::chrono::steady_clock::time_point timestamp,
+                               std::span<const uint8_t> payload) -> std::optional<std::error_code>
+    {
+        if (descriptor < 0) return std::make_error_code(std::errc::bad_file_descriptor);
+        if (entries++ % capture::index_stride == 0)
+            index.push_back({.timestamp_ns = to_ns(timestamp), .offset = offset});
+        if (auto error = put(kind, to_ns(timestamp), payload)) return error;
+        if (buffer.size() >= capture_flush_size) return flush();
+        return std::nullopt;
+    }
+
+    auto CaptureWriter::finish() -> std::optional<std::error_code>
+    {
+        if (descriptor < 0) return std::make_error_code(std::errc::bad_file_descriptor);
+        const capture::Trailer trailer{.index_offset = offset, .magic = capture::trailer_magic};
+        const uint64_t last = index.empty() ? 0 : index.back().timestamp_ns;
+        std::span<const uint8_t> points{reinterpret_cast<const uint8_t*>(index.data()),
+                                        index.size() * sizeof(capture::IndexPoint)};
+        auto error = put(capture::Kind::INDEX, last, points);
+        buffer.insert(buffer.end(), as_bytes(trailer).begin(), as_bytes(trailer).end());
+        if (!error) error = flush();
+        close(std::exchange(descriptor, -1));
+        return error;
+    }
+
+    auto CaptureWriter::put(capture::Kind kind,
+                            uint64_t timestamp_ns,
+                            std::span<const uint8_t> payload) -> std::optional<std::error_code>
+    {
+        if (payload.size() > UINT32_MAX) return std::make_error_code(std::errc::value_too_large);
+        const capture::EntryHeader header{
+            .timestamp_ns = timestamp_ns,
+            .size = static_cast<uint32_t>(payload.size()),
+            .kind = kind,
+        };
+        buffer.insert(buffer.end(), as_bytes(header).begin(), as_bytes(header).end());
+        buffer.insert(buffer.end(), payload.begin(), payload.end());
+        offset += sizeof(header) + payload.size();
+        return std::nullopt;
+    }
+
+    auto CaptureWriter::flush() -> std::optional<std::error_code>
+    {
+        std::span<const uint8_t> pending{buffer};
+        while (!pending.empty())
+        {
+            const ssize_t written = write(descriptor, pending.data(), pending.size());
+            if (written < 0 && errno == EINTR) continue;
+            if (written < 0) return std::error_code{errno, std::generic_category()};
+            pending = pending.subspan(written);
+        }
+        buffer.clear();
+        return std::nullopt;
+    }
+
+    auto CaptureReader::open(const char* path) -> tl::expected<CaptureReader, std::error_code>
+    {
+        const auto error = []()
+        { return tl::unexpected{std::error_code{errno, std::generic_category()}}; };
+        const auto mismatch = tl::unexpected{std::make_error_code(std::errc::wrong_protocol_type)};
+
+        const int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) return error();
+        struct stat status;
+        if (fstat(descriptor, &status) < 0)
+        {
+            auto failure = error();
+            close(descriptor);
+            return failure;
+        }
+        const auto size = static_cast<std::size_t>(status.st_size);
+        if (size < sizeof(capture::FileHeader))
+        {
+            close(descriptor);
+            return mismatch;
+        }
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (address == MAP_FAILED)
+        {
+            auto failure = error();
+            close(descriptor);
+            return failure;
+        }
+        close(descriptor);
+        Mapping memory{address, size};
+        // Replay walks the file front to back
+        madvise(memory.data(), size, MADV_SEQUENTIAL);
+
+        capture::FileHeader header;
+        std::memcpy(&header, memory.data(), sizeof(header));
+        if (header.magic != capture::magic || header.version != capture::version) return mismatch;
+
+        CaptureReader reader{std::move(memory), size};
+        reader.load_index();
+        return reader;
+    }
+
+    void CaptureReader::load_index()
+    {
+        capture::Trailer trailer{};
+        if (memory.size() >= sizeof(capture::FileHeader) + sizeof(trailer))
+            std::memcpy(&trailer, memory.data() + memory.size() - sizeof(trailer), sizeof(trailer));
+        if (trailer.magic == capture::trailer_magic)
+        {
+            auto entry = entry_at(trailer.index_offset);
+            if (entry && entry->kind == capture::Kind::INDEX
+                && entry->payload.size() % sizeof(capture::IndexPoint) == 0)
+            {
+                index.resize(entry->payload.size() / sizeof(capture::IndexPoint));
+                std::memcpy(index.data(), entry->payload.data(), entry->payload.size());
+                end = trailer.index_offset;
+                return;
+            }
+        }
+
+        // No usable index, the writer never finished. Scan and index every complete entry.
+        end = memory.size();
+        std::size_t offset = begin();
+        std::size_t entries = 0;
+        while (auto entry = entry_at(offset))
+        {
+            if (entry->kind == capture::Kind::INDEX) break;
+            if (entries++ % capture::index_stride == 0)
+                index.push_back({.timestamp_ns = to_ns(entry->timestamp), .offset = offset});
+            offset += sizeof(capture::EntryHeader) + entry->payload.size();
+        }
+        end = offset;
+    }
+
+    auto CaptureReader::seek(std::chrono::steady_clock::time_point timestamp) const -> std::size_t
+    {
+        auto first_after = std::ranges::lower_bound(
+            index, to_ns(timestamp), {}, &capture::IndexPoint::timestamp_ns);
+        std::size_t offset =
+            first_after == index.begin() ? begin() : std::prev(first_after)->offset;
+        std::size_t following = offset;
+        while (auto entry = next(following))
+        {
+            if (entry->timestamp >= timestamp) break;
+            offset = following;
+        }
+        return offset;
+    }
+
+    auto CaptureReader::next(std::size_t& offset) const -> std::optional<CaptureEntry>
+    {
+        auto entry = entry_at(offset);
+        if (entry) offset += sizeof(capture::EntryHeader) + entry->payload.size();
+        return entry;
+    }
+
+    auto CaptureReader::entry_at(std::size_t offset) const -> std::optional<CaptureEntry>
+    {
+        if (offset < begin() || offset > end || end - offset < sizeof(capture::EntryHeader))
+            return std::nullopt;
+        capture::EntryHeader header;
+        std::memcpy(&header, memory.data() + offset, sizeof(header));
+        if (header.kind > capture::Kind::INDEX) return std::nullopt;
+        if (end - offset - sizeof(header) < header.size) return std::nullopt;
+        return CaptureEntry{
+            .kind = header.kind,
+            .timestamp = std::chrono::steady_clock::time_point{
+                std::chrono::nanoseconds{header.timestamp_ns}},
+            .payload = {memory.data() + offset + sizeof(header), header.size},
+        };
+    }
+} // namespace mi
+#endif
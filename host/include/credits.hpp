@@ -0,0 +1,40 @@
+#pragma once
+
+#include "message_definitions.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace mi
+{
+    // Host side of the credit based flow control. The board sends a frame only while it holds a
+    // credit, `start` grants a whole window up front and `consume` tops it back up half a window
+    // at a time, so no more than `window` frames are ever in flight. A consumer that stops
+    // consuming stops granting, and the board stops sending instead of overflowing the buffers on
+    // the way.
+    struct CreditWindow
+    {
+        explicit CreditWindow(uint32_t window_) : window{window_ == 0 ? 1 : window_} {}
+
+        [[nodiscard]] auto start() -> StartStreamingData
+        {
+            consumed = 0;
+            return StartStreamingData{window};
+        }
+        // Frames lost on the way have to be consumed as well, or their credits leak for good
+        [[nodiscard]] auto consume(uint32_t frames = 1) -> std::optional<StartStreamingData>
+        {
+            consumed += frames;
+            const uint32_t refill = (window + 1) / 2;
+            if (consumed < refill) return std::nullopt;
+            const uint32_t granted = consumed;
+            consumed = 0;
+            return StartStreamingData{granted};
+        }
+
+        const uint32_t window;
+
+    private:
+        uint32_t consumed = 0;
+    };
+} // namespace mi
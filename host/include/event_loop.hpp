@@ -0,0 +1,138 @@
+#pragma once
+
+#include "tl-expected.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace mi
+{
+    // Level triggered epoll loop. A callback runs once per wake up with the events its
+    // descriptor is ready for, never per byte, so it should take as much as it can in one go.
+    // Callbacks may add and remove descriptors, their own included.
+    struct EventLoop
+    {
+        using Callback = std::function<void(uint32_t events)>;
+
+        [[nodiscard]] static auto create() -> tl::expected<EventLoop, std::error_code>;
+
+        EventLoop(EventLoop&& other) noexcept;
+        auto operator=(EventLoop&& other) noexcept -> EventLoop&;
+        EventLoop(const EventLoop&) = delete;
+        auto operator=(const EventLoop&) -> EventLoop& = delete;
+        ~EventLoop();
+
+        // Regular files can't be watched and fail with EPERM, they never block anyway
+        [[nodiscard]] auto add(int fd, uint32_t events, Callback callback)
+            -> std::optional<std::error_code>;
+        void remove(int fd);
+        // Dispatches events until `stop` is called or nothing is left to watch
+        auto run() -> std::optional<std::error_code>;
+        // Waits up to `timeout_ms` for a single round of events, -1 waits for good
+        auto run_once(int timeout_ms) -> std::optional<std::error_code>;
+        void stop() { running = false; }
+
+    private:
+        explicit EventLoop(int epoll_) : epoll{epoll_} {}
+
+        int epoll;
+        bool running = false;
+        std::unordered_map<int, std::unique_ptr<Callback>> callbacks;
+        // Callbacks removed while dispatching live until the round is over
+        std::vector<std::unique_ptr<Callback>> retired;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <array>
+#    include <cerrno>
+#    include <span>
+#    include <sys/epoll.h>
+#    include <unistd.h>
+#    include <utility>
+
+namespace mi
+{
+    auto EventLoop::create() -> tl::expected<EventLoop, std::error_code>
+    {
+        const int epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0) return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        return EventLoop{epoll};
+    }
+
+    EventLoop::EventLoop(EventLoop&& other) noexcept :
+        epoll{std::exchange(other.epoll, -1)},
+        running{other.running},
+        callbacks{std::move(other.callbacks)},
+        retired{std::move(other.retired)}
+    {
+    }
+
+    auto EventLoop::operator=(EventLoop&& other) noexcept -> EventLoop&
+    {
+        std::swap(epoll, other.epoll);
+        std::swap(running, other.running);
+        std::swap(callbacks, other.callbacks);
+        std::swap(retired, other.retired);
+        return *this;
+    }
+
+    EventLoop::~EventLoop()
+    {
+        if (epoll >= 0) close(epoll);
+    }
+
+    auto EventLoop::add(int fd, uint32_t events, Callback callback)
+        -> std::optional<std::error_code>
+    {
+        epoll_event event{.events = events, .data = {.fd = fd}};
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+            return std::error_code{errno, std::generic_category()};
+        callbacks[fd] = std::make_unique<Callback>(std::move(callback));
+        return std::nullopt;
+    }
+
+    void EventLoop::remove(int fd)
+    {
+        auto watched = callbacks.find(fd);
+        if (watched == callbacks.end()) return;
+        epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        retired.push_back(std::move(watched->second));
+        callbacks.erase(watched);
+    }
+
+    auto EventLoop::run() -> std::optional<std::error_code>
+    {
+        running = true;
+        while (running && !callbacks.empty())
+        {
+            if (auto error = run_once(-1)) return error;
+        }
+        return std::nullopt;
+    }
+
+    auto EventLoop::run_once(int timeout_ms) -> std::optional<std::error_code>
+    {
+        std::array<epoll_event, 16> events;
+        const int ready = epoll_wait(epoll, events.data(), events.size(), timeout_ms);
+        if (ready < 0 && errno == EINTR) return std::nullopt;
+        if (ready < 0) return std::error_code{errno, std::generic_category()};
+
+        for (const auto& event : std::span{events}.first(ready))
+        {
+            // An earlier callback of this round may have removed the descriptor
+            auto watched = callbacks.find(event.data.fd);
+            if (watched == callbacks.end()) continue;
+            Callback& callback = *watched->second;
+            callback(event.events);
+        }
+        retired.clear();
+        return std::nullopt;
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <span>
+#include <unistd.h>
+
+namespace mi
+{
+    // Byte sink writing every chunk it gets to a file descriptor. A message that fits the
+    // sender's chunk goes out in a single write, so threads sharing the descriptor can't
+    // interleave their bytes. A non-blocking descriptor is waited on until it takes the chunk, or
+    // for `timeout_ms` at most, after which the rest of the chunk is dropped.
+    struct FdSink
+    {
+        void operator()(std::span<const uint8_t> bytes) const
+        {
+            while (!bytes.empty())
+            {
+                const ssize_t written = write(fd, bytes.data(), bytes.size());
+                if (written < 0 && errno == EINTR) continue;
+                if (written < 0 && errno == EAGAIN)
+                {
+                    pollfd writable{.fd = fd, .events = POLLOUT, .revents = 0};
+                    const int ready = poll(&writable, 1, timeout_ms);
+                    if (ready == 0 || (ready < 0 && errno != EINTR)) return;
+                    continue;
+                }
+                if (written < 0) return;
+                bytes = bytes.subspan(written);
+            }
+        }
+
+        int fd;
+        // -1 waits for good
+        int timeout_ms = -1;
+    };
+} // namespace mi
@@ -4,49 +4,24 @@
 #include "message_definitions.hpp"
 #include "simple_fft/fft.hpp"
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <complex>
-#include <iostream>
 #include <numbers>
+#include <span>
 
 namespace mi
 {
+    // The board's spectrum pipeline, stage for stage, so spectra made on the host look like the
+    // ones the board sends. Only the transform differs: simple_fft stands in for CMSIS' rfft.
 
-    //#pragma GCC push_options
-    //#pragma GCC optimize ("-Ofast")
-
-    auto normalize(uint16_t value /* 12 bit precision */) -> float
+    inline auto normalize(uint16_t value /* 12 bit precision */) -> float
     {
         constexpr uint16_t mid_val = 1 << 11;
         float const normal = (static_cast<float>(value) / mid_val) - 1.F;
         return normal;
     }
 
-    template<std::size_t N, std::size_t Stride, typename Iterator, typename OutIterator>
-    void raw_fft(Iterator begin, OutIterator out)
-    {
-        using namespace std::complex_literals;
-        static_assert(N > 0);
-        if constexpr (N == 1)
-        {
-            *out = *begin;
-        }
-        else
-        {
-            raw_fft<N / 2, Stride * 2>(begin, out);
-            raw_fft<N / 2, Stride * 2>(begin + Stride, out + N / 2);
-
-            for (std::size_t k = 0; k < N / 2; ++k)
-            {
-                float const t = static_cast<float>(k) / N;
-                std::complex<float> const f = -2.F * std::numbers::pi_v<float> * t * 1if;
-                std::complex<float> const v = std::exp(f) * out[k + N / 2];
-                std::complex<float> const e = out[k];
-                out[k] = e + v;
-                out[k + N / 2] = e - v;
-            }
-        }
-    }
-
     template<std::size_t Samples, typename Iterator, typename OutIterator>
     void window(Iterator begin, OutIterator out)
     {
@@ -58,35 +33,85 @@ namespace mi
         }
     }
 
-    [[nodiscard]] auto amplitude(std::complex<float> const& value) -> float
+    [[nodiscard]] inline auto amplitude(std::complex<float> const& value) -> float
     {
-        float amp = 8.F;
-        float const a = (std::abs(value) + 1.F) * amp;
-        return std::log(a * a);
+        return std::log(std::abs(value));
     }
 
-    template<std::size_t Samples, typename Iterator, typename OutIterator>
-    [[nodiscard]] auto smooth(Iterator begin, OutIterator out, float dt)
+    template<std::size_t Samples>
+    [[nodiscard]] auto fft_impl(std::span<float, Samples> in) -> std::span<float, Samples / 2>
+    {
+        static std::array<std::complex<float>, Samples> out;
+        const char* err = nullptr;
+        simple_fft::FFT(in, out, Samples, err);
+        static std::array<float, Samples / 2> amps;
+        for (std::size_t i = 0; i < amps.size(); ++i)
+        {
+            amps[i] = amplitude(out[i]);
+        }
+        return std::span<float, Samples / 2>{amps};
+    }
+
+    // Merges the bins into bands `freq_data.step_freq` times wider than the one before, starting
+    // at bin `freq_data.min_freq`, and scales the loudest band to 1
+    template<std::size_t Samples>
+    [[nodiscard]] auto squash(std::span<float, Samples / 2> amps, SetFrequencyData freq_data)
+        -> std::span<float>
     {
-        constexpr float smoothness_factor = 20.F;
-        for (std::size_t i = 0; i < Samples / 2; ++i)
+        static std::array<float, Samples / 2> store;
+        size_t m = 0;
+        auto push = [&m](float f)
+        {
+            store[m++] = f;
+        };
+        // Anything else would never get past the first band
+        const float step = std::max(freq_data.step_freq, 1.001F);
+        const float lowf = static_cast<float>(std::max<uint32_t>(freq_data.min_freq, 1));
+        float max_amp = 1.0F;
+        for (float f = lowf; static_cast<std::size_t>(f) < Samples / 2; f = std::ceil(f * step))
         {
-            auto& v = *(begin + i + 1);
+            std::size_t f1 = static_cast<std::size_t>(std::ceil(f * step));
+            float a = 0.0f;
+            for (std::size_t q = static_cast<std::size_t>(f); q < Samples / 2 && q < f1; ++q)
+            {
+                a = std::max(amps[q], a);
+            }
+            max_amp = std::max(max_amp, a);
+            push(a);
+        }
+
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            store[i] /= max_amp;
+        }
+
+        return std::span<float>{store.data(), m};
+    }
+
+    template<typename Iterator, typename OutIterator>
+    void smooth(Iterator begin, OutIterator out, float dt, std::size_t m)
+    {
+        constexpr float smoothness_factor = 8.F;
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            auto& v = *(begin + i);
             auto& o = *(out + i);
-            o += (amplitude(v) - o) * smoothness_factor * dt;
+            o += (v - o) * smoothness_factor * dt;
         }
     }
 
-    template<std::size_t Samples, typename Iterator, typename OutIterator>
-    void quantize(Iterator begin, OutIterator out)
+    template<typename Iterator, typename OutIterator>
+    void quantize(Iterator begin, OutIterator out, std::size_t m)
     {
-        for (std::size_t i = 0; i < Samples / 2; ++i)
+        for (std::size_t i = 0; i < m; ++i)
         {
-            auto v = *(begin + i);
+            auto v = std::clamp(*(begin + i), 0.F, 1.F);
             *(out + i) = static_cast<uint8_t>(UINT8_MAX * v);
         }
     }
 
+    // The spectrum views a static buffer and is only valid until the next call. Smoothing
+    // carries over from call to call, like it does on the board.
     template<std::size_t Samples>
     auto fft(std::span<const uint16_t, Samples> input, SetFrequencyData freq_data, float dt)
         -> tl::expected<std::span<uint8_t>, Error>
@@ -97,18 +122,16 @@ namespace mi
         static std::array<float, Samples> windowed;
         window<Samples>(normalized.begin(), windowed.begin());
 
-        static std::array<std::complex<float>, Samples> raw{};
-        const char* err;
-        simple_fft::FFT(windowed, raw, Samples, err);
+        std::span<float, Samples / 2> raw = fft_impl<Samples>(windowed);
+
+        std::span<float> squashed = squash<Samples>(raw, freq_data);
 
         static std::array<float, Samples / 2> smoothed{};
-        smooth<Samples>(raw.begin(), smoothed.begin(), dt);
+        smooth(squashed.begin(), smoothed.begin(), dt, squashed.size());
 
         static std::array<uint8_t, Samples / 2> quantized;
-        quantize<Samples>(smoothed.begin(), quantized.begin());
+        quantize(smoothed.begin(), quantized.begin(), squashed.size());
 
-        return std::span<uint8_t>{quantized.begin(), Samples / 2};
+        return std::span<uint8_t>{quantized.begin(), squashed.size()};
     }
-
-    //#pragma GCC pop_options
 } // namespace mi
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "credits.hpp"
+#include "fd_sink.hpp"
+#include "receiver.hpp"
+#include "sender.hpp"
+#include "serial_port.hpp"
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <unistd.h>
+
+namespace mi
+{
+    // Host end of the board's data stream. Frames come from the serial port, or from stdin when
+    // there is none, and every frame consumed earns the board a credit back. The receiver views
+    // its own buffer, so a link stays where it was created.
+    struct Link
+    {
+        using Clock = std::chrono::steady_clock;
+        // The board drops its credits once heartbeats stay away for 3 s, and a frame whose STX
+        // got corrupted takes its credit along unseen. Either way the stream stalls with the
+        // board holding none, so a link that hears nothing for this long grants a whole window
+        // again.
+        constexpr static Clock::duration stall_timeout = std::chrono::seconds{3};
+        // A board that stops draining its UART must not hold up the loop the link runs on, so a
+        // message waits this long at most to go out and is dropped otherwise. Heartbeats repeat,
+        // and a lost grant is made up by the grant after `stall_timeout`.
+        constexpr static int write_timeout_ms = 20;
+
+        // Without a device there is nobody to grant credits to
+        [[nodiscard]] static auto open(const char* device, uint32_t baud, uint32_t window)
+            -> tl::expected<std::unique_ptr<Link>, std::error_code>;
+
+        // Takes whatever is pending in one read and calls `handler` with the result of collecting
+        // every frame in it. Returns false once the input is closed or broken.
+        template<typename Handler> auto read(Handler&& handler) -> bool;
+        // Without a device there is nobody to send to and messages are dropped
+        template<std::convertible_to<Message> ConcreteMessage>
+        [[nodiscard]] auto send(ConcreteMessage& message) -> std::optional<Error>;
+        // Keeps the board streaming, it stops once heartbeats stay away for too long. Also grants
+        // the window again when nothing came in for `stall_timeout`.
+        void heartbeat(Clock::time_point now = Clock::now());
+        [[nodiscard]] auto fd() const -> int { return port ? port->fd() : STDIN_FILENO; }
+        [[nodiscard]] auto stats() const -> const ReceiverStats& { return receiver.stats(); }
+        // When the bytes handed to the last handler arrived
+        [[nodiscard]] auto last_read() const -> Clock::time_point { return read_at; }
+        // The raw bytes of the last read, valid until the next one
+        [[nodiscard]] auto last_bytes() const -> std::span<const uint8_t>
+        {
+            return {read_buffer.data(), read_size};
+        }
+
+    private:
+        Link(std::optional<SerialPort> port_, uint32_t window);
+        void grant(StartStreamingData grant);
+
+        std::optional<SerialPort> port;
+        Receiver<max_encoded_size<Message>> receiver;
+        CreditWindow credits;
+        // Every message fits a chunk, so each goes out in a single write
+        std::optional<Sender<max_encoded_size<StartStreamingData, Heartbeat, SetFrequencyData,
+                                              StreamConfig>,
+                             FdSink>>
+            sender;
+        uint8_t heartbeat_seq = 0;
+        // Last time the window was granted or a frame came in
+        Clock::time_point progress_at = Clock::now();
+        Clock::time_point read_at;
+        std::size_t read_size = 0;
+        // Large enough for everything a multi megabaud link delivers between two wake ups
+        std::array<uint8_t, 1 << 16> read_buffer;
+    };
+
+    template<typename Handler> auto Link::read(Handler&& handler) -> bool
+    {
+        read_size = 0;
+        const ssize_t len = ::read(fd(), read_buffer.data(), read_buffer.size());
+        if (len < 0) return errno == EINTR || errno == EAGAIN;
+        if (len == 0) return false;
+        read_at = Clock::now();
+        read_size = static_cast<std::size_t>(len);
+
+        // Frames lost to a resync or an overflow were paid for by the board all the same
+        auto lost = [this]() { return receiver.stats().resyncs + receiver.stats().overflows; };
+        const std::size_t lost_before = lost();
+        const std::size_t frames = receiver.put(last_bytes(), handler) + lost() - lost_before;
+        if (frames > 0) progress_at = read_at;
+        if (auto refill = credits.consume(frames)) grant(refill.value());
+        return true;
+    }
+
+    template<std::convertible_to<Message> ConcreteMessage>
+    auto Link::send(ConcreteMessage& message) -> std::optional<Error>
+    {
+        if (!sender) return std::nullopt;
+        return sender->send(message);
+    }
+
+#ifdef MI_IMPLEMENT
+    auto Link::open(const char* device, uint32_t baud, uint32_t window)
+        -> tl::expected<std::unique_ptr<Link>, std::error_code>
+    {
+        std::optional<SerialPort> port;
+        if (device != nullptr)
+        {
+            auto opened = SerialPort::open(device, baud);
+            if (!opened.has_value()) return tl::unexpected{opened.error()};
+            port.emplace(std::move(opened.value()));
+        }
+        std::unique_ptr<Link> link{new Link{std::move(port), window}};
+        // The board ignores credits from a host it hasn't heard from
+        link->heartbeat();
+        link->grant(link->credits.start());
+        return link;
+    }
+
+    Link::Link(std::optional<SerialPort> port_, uint32_t window) :
+        port{std::move(port_)},
+        credits{window}
+    {
+        if (port) sender.emplace(FdSink{.fd = port->fd(), .timeout_ms = write_timeout_ms});
+    }
+
+    void Link::grant(StartStreamingData grant)
+    {
+        [[maybe_unused]] auto error = send(grant);
+    }
+
+    void Link::heartbeat(Clock::time_point now)
+    {
+        Heartbeat heartbeat{heartbeat_seq++};
+        [[maybe_unused]] auto error = send(heartbeat);
+        if (now - progress_at < stall_timeout) return;
+        grant(credits.start());
+        progress_at = now;
+    }
+#endif
+} // namespace mi
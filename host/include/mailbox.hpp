@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace mi
+{
+    // Hands the newest value from one producer thread to one consumer thread, whatever their
+    // rates. Triple buffered: the producer fills a buffer of its own and swaps it for the middle
+    // one, the consumer swaps the middle one for its own when it holds something new. Neither
+    // side ever waits for the other or copies a value, and a value replaced before the consumer
+    // took it counts as dropped. Buffers are reused, a T that keeps its storage allocates nothing
+    // once warmed up.
+    template<typename T> struct Mailbox
+    {
+        // Producer side: the buffer to fill, it still holds whatever was in it before
+        [[nodiscard]] auto back() -> T& { return buffers[back_index]; }
+        // Producer side: offers the filled buffer, replacing a value the consumer hasn't taken
+        void publish();
+        // Consumer side: the newest value if it wasn't taken yet, valid until the next take
+        [[nodiscard]] auto take() -> T*;
+
+        [[nodiscard]] auto published() const -> uint64_t
+        {
+            return published_count.load(std::memory_order_relaxed);
+        }
+        [[nodiscard]] auto dropped() const -> uint64_t
+        {
+            return dropped_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+        constexpr static uint8_t index_mask = 0b11;
+        constexpr static uint8_t fresh = 0b100;
+
+        std::array<T, 3> buffers{};
+        // Index of the middle buffer, flagged fresh while it holds a value not taken yet
+        alignas(64) std::atomic<uint8_t> middle{1};
+        std::atomic<uint64_t> published_count{0};
+        std::atomic<uint64_t> dropped_count{0};
+        alignas(64) uint8_t back_index = 0;
+        alignas(64) uint8_t front_index = 2;
+    };
+
+    template<typename T> void Mailbox<T>::publish()
+    {
+        const uint8_t previous = middle.exchange(back_index | fresh, std::memory_order_acq_rel);
+        if (previous & fresh) dropped_count.fetch_add(1, std::memory_order_relaxed);
+        published_count.fetch_add(1, std::memory_order_relaxed);
+        back_index = previous & index_mask;
+    }
+
+    template<typename T> auto Mailbox<T>::take() -> T*
+    {
+        // Only the producer sets the flag, so one seen here is still set at the exchange
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) return nullptr;
+        const uint8_t previous = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & index_mask;
+        return &buffers[front_index];
+    }
+} // namespace mi
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mi
+{
+    // An mmap'ed region, unmapped when it goes out of scope
+    struct Mapping
+    {
+        Mapping(void* address_, std::size_t size_) : address{address_}, length{size_} {}
+        Mapping(Mapping&& other) noexcept;
+        auto operator=(Mapping&& other) noexcept -> Mapping&;
+        Mapping(const Mapping&) = delete;
+        auto operator=(const Mapping&) -> Mapping& = delete;
+        ~Mapping();
+
+        [[nodiscard]] auto data() const -> uint8_t* { return static_cast<uint8_t*>(address); }
+        [[nodiscard]] auto size() const -> std::size_t { return length; }
+
+    private:
+        void* address;
+        std::size_t length;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <sys/mman.h>
+#    include <utility>
+
+namespace mi
+{
+    Mapping::Mapping(Mapping&& other) noexcept :
+        address{std::exchange(other.address, nullptr)}, length{other.length}
+    {
+    }
+
+    auto Mapping::operator=(Mapping&& other) noexcept -> Mapping&
+    {
+        std::swap(address, other.address);
+        std::swap(length, other.length);
+        return *this;
+    }
+
+    Mapping::~Mapping()
+    {
+        if (address != nullptr) munmap(address, length);
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "message_definitions.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace mi
+{
+    // Packed samples go two to three bytes, low sample first and little endian. Delta coded
+    // samples start with the first sample as two little endian bytes, every following sample is
+    // a signed byte difference to its predecessor, or `escape` followed by the raw sample when
+    // the difference doesn't fit.
+    namespace raw
+    {
+        constexpr static std::size_t sample_bits = RawSamples::sample_bits;
+        constexpr static uint16_t sample_mask = (1U << sample_bits) - 1;
+        constexpr static int8_t escape = INT8_MIN;
+
+        [[nodiscard]] constexpr auto packed_size(std::size_t count) -> std::size_t
+        {
+            return (count * sample_bits + UINT8_WIDTH - 1) / UINT8_WIDTH;
+        }
+
+        inline void pack(std::span<const uint16_t> samples, uint8_t* out)
+        {
+            std::size_t i = 0;
+            for (; i + 1 < samples.size(); i += 2)
+            {
+                const uint16_t low = samples[i] & sample_mask;
+                const uint16_t high = samples[i + 1] & sample_mask;
+                *(out++) = low & UINT8_MAX;
+                *(out++) = (low >> UINT8_WIDTH) | ((high & 0x0F) << 4);
+                *(out++) = high >> 4;
+            }
+            if (i == samples.size()) return;
+            *(out++) = samples[i] & UINT8_MAX;
+            *out = (samples[i] & sample_mask) >> UINT8_WIDTH;
+        }
+
+        inline void unpack(std::span<const uint8_t> packed, std::size_t count, uint16_t* out)
+        {
+            const uint8_t* in = packed.data();
+            std::size_t i = 0;
+            for (; i + 1 < count; i += 2, in += 3)
+            {
+                *(out++) = in[0] | ((in[1] & 0x0F) << UINT8_WIDTH);
+                *(out++) = (in[1] >> 4) | (in[2] << 4);
+            }
+            if (i < count) *out = in[0] | ((in[1] & 0x0F) << UINT8_WIDTH);
+        }
+
+        // Returns the coded size, or nothing when the coded samples don't fit `out`
+        [[nodiscard]] inline auto delta_pack(std::span<const uint16_t> samples,
+                                             std::span<uint8_t> out) -> std::optional<std::size_t>
+        {
+            std::size_t size = 0;
+            auto put_raw = [&out, &size](uint16_t sample) -> bool
+            {
+                if (size + 2 > out.size()) return false;
+                out[size++] = sample & UINT8_MAX;
+                out[size++] = (sample & sample_mask) >> UINT8_WIDTH;
+                return true;
+            };
+
+            if (samples.empty()) return 0;
+            if (!put_raw(samples[0])) return std::nullopt;
+            for (std::size_t i = 1; i < samples.size(); ++i)
+            {
+                const int diff = (samples[i] & sample_mask) - (samples[i - 1] & sample_mask);
+                if (diff > escape && diff <= INT8_MAX)
+                {
+                    if (size == out.size()) return std::nullopt;
+                    out[size++] = static_cast<uint8_t>(diff);
+                    continue;
+                }
+                if (size == out.size()) return std::nullopt;
+                out[size++] = static_cast<uint8_t>(escape);
+                if (!put_raw(samples[i])) return std::nullopt;
+            }
+            return size;
+        }
+
+        [[nodiscard]] inline auto delta_unpack(std::span<const uint8_t> coded,
+                                               std::size_t count,
+                                               uint16_t* out) -> bool
+        {
+            std::size_t at = 0;
+            auto take_raw = [&coded, &at]() -> std::optional<uint16_t>
+            {
+                if (at + 2 > coded.size()) return std::nullopt;
+                const uint16_t sample = coded[at] | ((coded[at + 1] & 0x0F) << UINT8_WIDTH);
+                at += 2;
+                return sample;
+            };
+
+            if (count == 0) return coded.empty();
+            auto previous = take_raw();
+            if (!previous) return false;
+            out[0] = *previous;
+            for (std::size_t i = 1; i < count; ++i)
+            {
+                if (at == coded.size()) return false;
+                const auto diff = static_cast<int8_t>(coded[at++]);
+                if (diff == escape)
+                {
+                    previous = take_raw();
+                    if (!previous) return false;
+                }
+                else
+                {
+                    previous = (*previous + diff) & sample_mask;
+                }
+                out[i] = *previous;
+            }
+            return at == coded.size();
+        }
+    } // namespace raw
+
+    template<std::size_t MaxSamples> struct SampleEncoder
+    {
+        // Delta coding falls back to packing when it doesn't come out smaller. The returned frame
+        // views the encoder's buffer and is valid until the next call.
+        [[nodiscard]] auto encode(std::span<const uint16_t> samples, bool delta)
+            -> tl::expected<RawSamples, Error>;
+
+    private:
+        uint8_t next_seq = 0;
+        std::array<uint8_t, RawSamples::header_size + raw::packed_size(MaxSamples)> buffer;
+    };
+
+    template<std::size_t MaxSamples>
+    auto SampleEncoder<MaxSamples>::encode(std::span<const uint16_t> samples, bool delta)
+        -> tl::expected<RawSamples, Error>
+    {
+        if (samples.size() > MaxSamples) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        std::span<uint8_t> coded{buffer.begin() + RawSamples::header_size,
+                                 raw::packed_size(samples.size())};
+        std::optional<std::size_t> coded_size;
+        if (delta && !coded.empty())
+        {
+            coded_size = raw::delta_pack(samples, coded.first(coded.size() - 1));
+        }
+
+        buffer[1] = coded_size.has_value() ? RawSamples::delta_coding : RawSamples::packed_coding;
+        if (!coded_size.has_value())
+        {
+            raw::pack(samples, coded.data());
+            coded_size = coded.size();
+        }
+
+        buffer[0] = next_seq++;
+        buffer[2] = samples.size() & UINT8_MAX;
+        buffer[3] = samples.size() >> UINT8_WIDTH;
+        return RawSamples{{buffer.begin(), RawSamples::header_size + *coded_size}};
+    }
+
+    template<std::size_t MaxSamples> struct SampleDecoder
+    {
+        // The returned samples view the decoder's buffer and are valid until the next call
+        [[nodiscard]] auto decode(const RawSamples& frame)
+            -> tl::expected<std::span<uint16_t>, Error>;
+
+    private:
+        std::array<uint16_t, MaxSamples> samples;
+    };
+
+    template<std::size_t MaxSamples>
+    auto SampleDecoder<MaxSamples>::decode(const RawSamples& frame)
+        -> tl::expected<std::span<uint16_t>, Error>
+    {
+        if (frame.count() > MaxSamples) return tl::unexpected{Error::OUT_OF_MEMORY};
+
+        if (frame.coding() == RawSamples::packed_coding)
+        {
+            raw::unpack(frame.coded(), frame.count(), samples.data());
+        }
+        else if (!raw::delta_unpack(frame.coded(), frame.count(), samples.data()))
+        {
+            return tl::unexpected{Error::INCOMPLETE};
+        }
+        return std::span<uint16_t>{samples.begin(), frame.count()};
+    }
+} // namespace mi
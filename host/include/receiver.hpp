@@ -4,69 +4,154 @@
 
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <span>
 #include <tl-expected.hpp>
 
 namespace mi
 {
+    struct ReceiverStats
+    {
+        std::size_t resyncs = 0;         // Frames abandoned because a fresh STX showed up
+        std::size_t overflows = 0;       // Frames abandoned because they didn't fit the buffer
+        std::size_t crc_failures = 0;    // Complete frames rejected by the CRC check
+        std::size_t discarded_bytes = 0; // Bytes that never made it into a collected frame
+    };
+
+    // Every STX starts a new frame, whatever state the receiver is in, and a frame that outgrows
+    // the buffer is dropped on the spot, so a corrupted link costs at most the frame in flight.
     template<std::size_t MessageBufferSize> struct Receiver
     {
         void put(uint8_t byte);
+        // Consumes a whole read buffer, calls `handler` with the result of collecting every frame
+        // completed inside it and returns how many frames were handed out. Messages passed to the
+        // handler view the receiver's buffer, so they are only valid until the handler returns.
+        template<typename Handler>
+        auto put(std::span<const uint8_t> bytes, Handler&& handler) -> std::size_t;
         [[nodiscard]] auto collect() -> tl::expected<Message, Error>;
         [[nodiscard]] auto ready() -> bool { return reception_state == ETX_RECEIVED; }
+        [[nodiscard]] auto stats() const -> const ReceiverStats& { return statistics; }
 
     private:
         void reset();
+        void restart();
+        void drop_frame();
+        [[nodiscard]] auto frame_size() const -> std::size_t
+        {
+            return recv_ptr - encoded_recv_buffer.data();
+        }
 
         enum ReceptionState
         {
             IDLE,
             STX_RECEIVED,
             ETX_RECEIVED,
-            NO_MORE_SPACE
         };
 
         std::array<uint8_t, MessageBufferSize> recv_buffer;
         std::array<uint8_t, MessageBufferSize> encoded_recv_buffer;
         uint8_t* recv_ptr = &encoded_recv_buffer[0];
         ReceptionState reception_state = IDLE;
+        ReceiverStats statistics;
     };
 
     template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::put(uint8_t byte)
     {
-        if (recv_ptr == encoded_recv_buffer.end())
+        if (byte == magic::stx)
         {
-            reception_state = NO_MORE_SPACE;
+            restart();
             return;
         }
-        *(recv_ptr++) = byte;
-        if (byte == magic::stx && reception_state == IDLE)
+        if (reception_state != STX_RECEIVED)
         {
-            reception_state = STX_RECEIVED;
+            ++statistics.discarded_bytes;
             return;
         }
-        if (byte == magic::etx && reception_state == STX_RECEIVED)
+        if (recv_ptr == encoded_recv_buffer.end())
         {
-            reception_state = ETX_RECEIVED;
+            ++statistics.overflows;
+            ++statistics.discarded_bytes;
+            drop_frame();
             return;
         }
+        *(recv_ptr++) = byte;
+        if (byte == magic::etx) reception_state = ETX_RECEIVED;
+    }
+
+    template<std::size_t MessageBufferSize>
+    template<typename Handler>
+    auto Receiver<MessageBufferSize>::put(std::span<const uint8_t> bytes, Handler&& handler)
+        -> std::size_t
+    {
+        std::size_t frames = 0;
+        while (!bytes.empty())
+        {
+            if (reception_state != STX_RECEIVED)
+            {
+                // Nothing before a STX can ever be part of a frame, so skip it without copying
+                const auto* stx = static_cast<const uint8_t*>(
+                    std::memchr(bytes.data(), magic::stx, bytes.size()));
+                if (stx == nullptr)
+                {
+                    statistics.discarded_bytes += bytes.size();
+                    break;
+                }
+                statistics.discarded_bytes += stx - bytes.data();
+                bytes = bytes.subspan(stx - bytes.data() + 1);
+                restart();
+                continue;
+            }
+
+            const auto* etx = static_cast<const uint8_t*>(
+                std::memchr(bytes.data(), magic::etx, bytes.size()));
+            const std::size_t chunk = etx == nullptr ? bytes.size() : etx - bytes.data() + 1;
+            const auto* stx =
+                static_cast<const uint8_t*>(std::memchr(bytes.data(), magic::stx, chunk));
+            if (stx != nullptr)
+            {
+                statistics.discarded_bytes += stx - bytes.data();
+                bytes = bytes.subspan(stx - bytes.data() + 1);
+                restart();
+                continue;
+            }
+            if (chunk > static_cast<std::size_t>(encoded_recv_buffer.end() - recv_ptr))
+            {
+                ++statistics.overflows;
+                statistics.discarded_bytes += chunk;
+                drop_frame();
+                bytes = bytes.subspan(chunk);
+                continue;
+            }
+
+            recv_ptr = std::copy_n(bytes.data(), chunk, recv_ptr);
+            bytes = bytes.subspan(chunk);
+            if (etx == nullptr) break;
+
+            reception_state = ETX_RECEIVED;
+            handler(collect());
+            ++frames;
+        }
+        return frames;
     }
 
     template<std::size_t MessageBufferSize>
     auto Receiver<MessageBufferSize>::collect() -> tl::expected<Message, Error>
     {
-        if (reception_state == NO_MORE_SPACE) return tl::unexpected{Error::OUT_OF_MEMORY};
         if (!ready()) return tl::unexpected{Error::MESSAGE_NOT_READY};
-        reset();
 
-        auto encoded_view = encoded_data_view{encoded_recv_buffer};
+        // The buffer always starts at the STX and ends at the ETX, no need to search for them
+        auto encoded_view = encoded_data_view{encoded_recv_buffer.data(), frame_size()};
         auto message_view = data_view{recv_buffer};
-        auto truncated = message_t::truncate(encoded_view);
+        reset();
 
-        if (!truncated) return tl::unexpected{truncated.error()};
-        if (auto error = truncated->decode(message_view)) return tl::unexpected{error.value()};
+        if (auto error = encoded_view.decode(message_view)) return tl::unexpected{error.value()};
 
         auto message = message_t::deserialize(message_view);
-        if (!message) return tl::unexpected{message.error()};
+        if (!message)
+        {
+            if (message.error() == Error::INVALID_CRC) ++statistics.crc_failures;
+            return tl::unexpected{message.error()};
+        }
 
         auto statically_typed = static_type(message.value());
         if (!statically_typed) return tl::unexpected{statically_typed.error()};
@@ -79,4 +164,22 @@ namespace mi
         recv_ptr = &encoded_recv_buffer[0];
         reception_state = IDLE;
     }
-} // namespace mi
\ No newline at end of file
+
+    template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::restart()
+    {
+        if (reception_state == STX_RECEIVED)
+        {
+            ++statistics.resyncs;
+            statistics.discarded_bytes += frame_size();
+        }
+        recv_ptr = &encoded_recv_buffer[0];
+        *(recv_ptr++) = magic::stx;
+        reception_state = STX_RECEIVED;
+    }
+
+    template<std::size_t MessageBufferSize> void Receiver<MessageBufferSize>::drop_frame()
+    {
+        statistics.discarded_bytes += frame_size();
+        reset();
+    }
+} // namespace mi
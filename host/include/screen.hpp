@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mi
+{
+    // Grid of terminal cells that remembers what the terminal shows. A frame is built from
+    // scratch every time, and flushing it only emits the cells that differ from the frame before,
+    // each run of them preceded by a cursor move. What's written scales with how much of the
+    // picture changes, not with its size.
+    struct Screen
+    {
+        // One column wide glyph, up to 4 bytes of UTF-8
+        struct Cell
+        {
+            std::array<char, 4> bytes{' '};
+            uint8_t size = 1;
+
+            [[nodiscard]] auto view() const -> std::string_view { return {bytes.data(), size}; }
+            [[nodiscard]] auto operator==(const Cell&) const -> bool = default;
+        };
+
+        // Starts the next frame, `rows` by `columns` blank cells
+        void clear(std::size_t rows_, std::size_t columns_);
+        void put(std::size_t row, std::size_t column, std::string_view glyph);
+        void put(std::size_t row, std::size_t column, const Cell& cell)
+        {
+            if (row < height && column < width) cells[row * width + column] = cell;
+        }
+        // One ASCII character per cell from `column` on, cut at the right edge
+        void print(std::size_t row, std::size_t column, std::string_view text);
+        // Appends the escapes and glyphs that turn the frame shown into this one to `out`, and
+        // takes this one as shown. A change of size clears the terminal and redraws it all.
+        void flush(std::string& out);
+        // Something else wrote to the terminal, the next flush redraws everything
+        void invalidate() { shown.clear(); }
+
+        [[nodiscard]] auto rows() const -> std::size_t { return height; }
+        [[nodiscard]] auto columns() const -> std::size_t { return width; }
+
+    private:
+        std::size_t height = 0;
+        std::size_t width = 0;
+        std::vector<Cell> cells;
+        std::vector<Cell> shown;
+        std::size_t shown_width = 0;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <algorithm>
+#    include <charconv>
+#    include <cstring>
+
+namespace mi
+{
+    namespace
+    {
+        // CUP, formatted by hand since it's the one escape sent per changed run of cells
+        void move_cursor(std::string& out, std::size_t row, std::size_t column)
+        {
+            std::array<char, 20> digits;
+            out += "\x1b[";
+            out.append(digits.data(), std::to_chars(digits.begin(), digits.end(), row + 1).ptr);
+            out += ';';
+            out.append(digits.data(), std::to_chars(digits.begin(), digits.end(), column + 1).ptr);
+            out += 'H';
+        }
+    } // namespace
+
+    void Screen::clear(std::size_t rows_, std::size_t columns_)
+    {
+        height = rows_;
+        width = columns_;
+        cells.assign(height * width, Cell{});
+    }
+
+    void Screen::put(std::size_t row, std::size_t column, std::string_view glyph)
+    {
+        if (row >= height || column >= width) return;
+        Cell& cell = cells[row * width + column];
+        cell.size = static_cast<uint8_t>(std::min(glyph.size(), cell.bytes.size()));
+        std::memcpy(cell.bytes.data(), glyph.data(), cell.size);
+    }
+
+    void Screen::print(std::size_t row, std::size_t column, std::string_view text)
+    {
+        if (row >= height || column >= width) return;
+        text = text.substr(0, width - column);
+        for (char c : text)
+            cells[row * width + column++] = Cell{.bytes = {c}, .size = 1};
+    }
+
+    void Screen::flush(std::string& out)
+    {
+        if (shown.size() != cells.size() || shown_width != width)
+        {
+            out += "\x1b[2J";
+            // Empty cells never match, so all of them get drawn
+            shown.assign(cells.size(), Cell{.bytes = {}, .size = 0});
+            shown_width = width;
+        }
+
+        // A cursor move costs up to 8 bytes, rewriting a few unchanged cells is cheaper
+        constexpr std::size_t max_gap = 4;
+        std::size_t cursor_row = SIZE_MAX;
+        std::size_t cursor_column = 0;
+        for (std::size_t row = 0; row < height; ++row)
+        {
+            for (std::size_t column = 0; column < width; ++column)
+            {
+                const std::size_t i = row * width + column;
+                if (cells[i] == shown[i]) continue;
+
+                if (row == cursor_row && column >= cursor_column
+                    && column - cursor_column <= max_gap)
+                {
+                    for (; cursor_column < column; ++cursor_column)
+                        out += cells[row * width + cursor_column].view();
+                }
+                else
+                {
+                    move_cursor(out, row, column);
+                }
+                out += cells[i].view();
+                cursor_row = row;
+                cursor_column = column + 1;
+            }
+        }
+        // Same size, so the copy reuses the storage
+        shown = cells;
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "tl-expected.hpp"
+
+#include <cstdint>
+#include <span>
+#include <system_error>
+
+namespace mi
+{
+    // A tty in raw mode, at any rate the driver accepts. The rate is set through termios2 and
+    // BOTHER rather than the fixed Bxxx constants, so 921600, 2 Mbaud and whatever else the
+    // ST-LINK virtual COM port supports all work. Reads and writes never block, wait on `fd` with
+    // poll or epoll instead.
+    struct SerialPort
+    {
+        [[nodiscard]] static auto open(const char* path, uint32_t baud)
+            -> tl::expected<SerialPort, std::error_code>;
+
+        SerialPort(SerialPort&& other) noexcept;
+        auto operator=(SerialPort&& other) noexcept -> SerialPort&;
+        SerialPort(const SerialPort&) = delete;
+        auto operator=(const SerialPort&) -> SerialPort& = delete;
+        ~SerialPort();
+
+        // Both return 0 when the port isn't ready, a hang up is an error
+        [[nodiscard]] auto read(std::span<uint8_t> bytes)
+            -> tl::expected<std::size_t, std::error_code>;
+        [[nodiscard]] auto write(std::span<const uint8_t> bytes)
+            -> tl::expected<std::size_t, std::error_code>;
+        [[nodiscard]] auto fd() const -> int { return descriptor; }
+
+    private:
+        explicit SerialPort(int descriptor_) : descriptor{descriptor_} {}
+
+        int descriptor;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+// <asm/termbits.h> clashes with <termios.h>, which must not be included alongside
+#    include <asm/termbits.h>
+#    include <cerrno>
+#    include <fcntl.h>
+#    include <sys/ioctl.h>
+#    include <unistd.h>
+#    include <utility>
+
+namespace mi
+{
+    namespace
+    {
+        auto last_error() -> std::error_code { return {errno, std::generic_category()}; }
+    } // namespace
+
+    auto SerialPort::open(const char* path, uint32_t baud)
+        -> tl::expected<SerialPort, std::error_code>
+    {
+        const int descriptor = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (descriptor < 0) return tl::unexpected{last_error()};
+        SerialPort port{descriptor};
+
+        termios2 tty{};
+        if (ioctl(descriptor, TCGETS2, &tty) < 0) return tl::unexpected{last_error()};
+        tty.c_iflag = 0; // No software flow control, no CR/NL translation
+        tty.c_oflag = 0;
+        tty.c_lflag = 0; // No line discipline, echo or signals
+        tty.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT) | CSIZE | PARENB | CSTOPB | CRTSCTS);
+        tty.c_cflag |= BOTHER | (BOTHER << IBSHIFT) | CS8 | CLOCAL | CREAD;
+        tty.c_ispeed = baud;
+        tty.c_ospeed = baud;
+        // Together with O_NONBLOCK an empty port reads EAGAIN, leaving 0 to mean a hang up
+        tty.c_cc[VMIN] = 1;
+        tty.c_cc[VTIME] = 0;
+        if (ioctl(descriptor, TCSETS2, &tty) < 0) return tl::unexpected{last_error()};
+
+        // Whatever piled up while nobody was listening is stale
+        if (ioctl(descriptor, TCFLSH, TCIOFLUSH) < 0) return tl::unexpected{last_error()};
+        return port;
+    }
+
+    SerialPort::SerialPort(SerialPort&& other) noexcept :
+        descriptor{std::exchange(other.descriptor, -1)}
+    {
+    }
+
+    auto SerialPort::operator=(SerialPort&& other) noexcept -> SerialPort&
+    {
+        std::swap(descriptor, other.descriptor);
+        return *this;
+    }
+
+    SerialPort::~SerialPort()
+    {
+        if (descriptor >= 0) close(descriptor);
+    }
+
+    auto SerialPort::read(std::span<uint8_t> bytes) -> tl::expected<std::size_t, std::error_code>
+    {
+        while (true)
+        {
+            const ssize_t len = ::read(descriptor, bytes.data(), bytes.size());
+            if (len > 0) return static_cast<std::size_t>(len);
+            if (len == 0) return tl::unexpected{std::make_error_code(std::errc::no_such_device)};
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return 0;
+            return tl::unexpected{last_error()};
+        }
+    }
+
+    auto SerialPort::write(std::span<const uint8_t> bytes)
+        -> tl::expected<std::size_t, std::error_code>
+    {
+        while (true)
+        {
+            const ssize_t len = ::write(descriptor, bytes.data(), bytes.size());
+            if (len >= 0) return static_cast<std::size_t>(len);
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return 0;
+            return tl::unexpected{last_error()};
+        }
+    }
+} // namespace mi
+#endif
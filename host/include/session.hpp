@@ -0,0 +1,147 @@
+#pragma once
+
+#include "event_loop.hpp"
+#include "link.hpp"
+#include "timer.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace mi
+{
+    // Sends `link` a heartbeat every `interval` from `loop`, for tools that read a link
+    // themselves. Opening the link sent the first one. The heartbeats stop once the returned
+    // timer is gone.
+    [[nodiscard]] auto keep_alive(EventLoop& loop,
+                                  Link& link,
+                                  std::chrono::nanoseconds interval = std::chrono::seconds{1})
+        -> tl::expected<std::unique_ptr<Timer>, std::error_code>;
+
+    // A board's whole conversation on one event loop: frames come in, and credits, commands and a
+    // heartbeat from a timerfd go out, all from the loop's thread. Nothing blocks waiting for the
+    // board, a send it doesn't take gives up after `Link::write_timeout_ms`, and nothing needs a
+    // thread of its own. The session stays where it was created, because the loop's callbacks
+    // point at it.
+    struct Session
+    {
+        using MessageHandler = std::function<void(tl::expected<Message, Error>)>;
+        // `on_message` is called with every frame collected from the device. `on_closed` is
+        // called once the device hangs up, the session is left inert after that.
+        [[nodiscard]] static auto open(EventLoop& loop,
+                                       const char* device,
+                                       uint32_t baud,
+                                       uint32_t window,
+                                       MessageHandler on_message,
+                                       std::function<void()> on_closed)
+            -> tl::expected<std::unique_ptr<Session>, std::error_code>;
+
+        Session(const Session&) = delete;
+        auto operator=(const Session&) -> Session& = delete;
+        ~Session();
+
+        template<std::convertible_to<Message> ConcreteMessage>
+        [[nodiscard]] auto send(ConcreteMessage& message) -> std::optional<Error>
+        {
+            return link->send(message);
+        }
+        [[nodiscard]] auto stats() const -> const ReceiverStats& { return link->stats(); }
+        [[nodiscard]] auto last_read() const -> Link::Clock::time_point
+        {
+            return link->last_read();
+        }
+
+    private:
+        Session(EventLoop& loop_,
+                std::unique_ptr<Link> link_,
+                std::unique_ptr<Timer> heartbeat_,
+                MessageHandler on_message_,
+                std::function<void()> on_closed_);
+        void close();
+
+        EventLoop& loop;
+        std::unique_ptr<Link> link;
+        std::unique_ptr<Timer> heartbeat;
+        MessageHandler on_message;
+        std::function<void()> on_closed;
+        bool closed = false;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <sys/epoll.h>
+
+namespace mi
+{
+    auto keep_alive(EventLoop& loop, Link& link, std::chrono::nanoseconds interval)
+        -> tl::expected<std::unique_ptr<Timer>, std::error_code>
+    {
+        auto created = Timer::create(interval);
+        if (!created.has_value()) return tl::unexpected{created.error()};
+        auto timer = std::make_unique<Timer>(std::move(created.value()));
+        auto on_tick = [&timer = *timer, &link](uint32_t)
+        {
+            if (timer.expirations() > 0) link.heartbeat();
+        };
+        if (auto error = loop.add(timer->fd(), EPOLLIN, on_tick))
+            return tl::unexpected{error.value()};
+        return timer;
+    }
+
+    auto Session::open(EventLoop& loop,
+                       const char* device,
+                       uint32_t baud,
+                       uint32_t window,
+                       MessageHandler on_message,
+                       std::function<void()> on_closed)
+        -> tl::expected<std::unique_ptr<Session>, std::error_code>
+    {
+        auto link = Link::open(device, baud, window);
+        if (!link.has_value()) return tl::unexpected{link.error()};
+        auto heartbeat = keep_alive(loop, *link.value());
+        if (!heartbeat.has_value()) return tl::unexpected{heartbeat.error()};
+
+        std::unique_ptr<Session> session{new Session{loop,
+                                                     std::move(link.value()),
+                                                     std::move(heartbeat.value()),
+                                                     std::move(on_message),
+                                                     std::move(on_closed)}};
+        Session& self = *session;
+        auto on_readable = [&self](uint32_t)
+        {
+            if (!self.link->read(self.on_message)) self.close();
+        };
+        if (auto error = loop.add(self.link->fd(), EPOLLIN, on_readable))
+            return tl::unexpected{error.value()};
+        return session;
+    }
+
+    Session::Session(EventLoop& loop_,
+                     std::unique_ptr<Link> link_,
+                     std::unique_ptr<Timer> heartbeat_,
+                     MessageHandler on_message_,
+                     std::function<void()> on_closed_) :
+        loop{loop_},
+        link{std::move(link_)},
+        heartbeat{std::move(heartbeat_)},
+        on_message{std::move(on_message_)},
+        on_closed{std::move(on_closed_)}
+    {
+    }
+
+    Session::~Session()
+    {
+        loop.remove(link->fd());
+        loop.remove(heartbeat->fd());
+    }
+
+    void Session::close()
+    {
+        if (closed) return;
+        closed = true;
+        loop.remove(link->fd());
+        loop.remove(heartbeat->fd());
+        if (on_closed) on_closed();
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "tl-expected.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace mi
+{
+    // Stands in for the board's ADC: a mix of tones, a sweep and noise, or a WAV file played in
+    // a loop, sampled as the ADC's 12 bit readings. Levels are relative to full scale, and the
+    // mix is clipped like a signal driving the ADC past its rails.
+    struct SignalSource
+    {
+        struct Tone
+        {
+            float frequency;
+            float level = 0.5F;
+        };
+        // Glides from `from` to `to` over `seconds`, then starts over
+        struct Sweep
+        {
+            float from;
+            float to;
+            float seconds;
+            float level = 0.5F;
+        };
+
+        explicit SignalSource(float rate_) : rate{rate_} {}
+        // The file's own sample rate replaces the ADC's. 8 and 16 bit PCM and 32 bit float are
+        // understood, channels are mixed down to one.
+        [[nodiscard]] static auto open_wav(const char* path)
+            -> tl::expected<SignalSource, std::error_code>;
+
+        void fill(std::span<uint16_t> samples);
+        [[nodiscard]] auto sample_rate() const -> float { return rate; }
+
+        std::vector<Tone> tones;
+        std::optional<Sweep> sweep;
+        float noise = 0.F;
+
+    private:
+        [[nodiscard]] auto next() -> float;
+
+        float rate;
+        std::vector<float> recording;
+        std::size_t position = 0;
+        std::vector<double> phases;
+        double sweep_phase = 0.;
+        uint64_t sweep_sample = 0;
+        std::minstd_rand rng{1};
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <algorithm>
+#    include <array>
+#    include <cerrno>
+#    include <cmath>
+#    include <cstring>
+#    include <fcntl.h>
+#    include <numbers>
+#    include <unistd.h>
+
+namespace mi
+{
+    namespace
+    {
+        template<typename T> auto read_le(const uint8_t* bytes) -> T
+        {
+            T value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+
+        auto read_file(const char* path) -> tl::expected<std::vector<uint8_t>, std::error_code>
+        {
+            const auto error = []()
+            { return tl::unexpected{std::error_code{errno, std::generic_category()}}; };
+            const int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (descriptor < 0) return error();
+            std::vector<uint8_t> contents;
+            std::array<uint8_t, 65536> chunk;
+            while (true)
+            {
+                const ssize_t len = read(descriptor, chunk.data(), chunk.size());
+                if (len < 0 && errno == EINTR) continue;
+                if (len < 0)
+                {
+                    auto failure = error();
+                    close(descriptor);
+                    return failure;
+                }
+                if (len == 0) break;
+                contents.insert(contents.end(), chunk.begin(), chunk.begin() + len);
+            }
+            close(descriptor);
+            return contents;
+        }
+    } // namespace
+
+    auto SignalSource::open_wav(const char* path) -> tl::expected<SignalSource, std::error_code>
+    {
+        const auto mismatch = tl::unexpected{std::make_error_code(std::errc::wrong_protocol_type)};
+        auto contents = read_file(path);
+        if (!contents.has_value()) return tl::unexpected{contents.error()};
+        const std::span<const uint8_t> file{contents.value()};
+        if (file.size() < 12 || std::memcmp(file.data(), "RIFF", 4) != 0
+            || std::memcmp(file.data() + 8, "WAVE", 4) != 0)
+            return mismatch;
+
+        uint16_t format = 0;
+        uint16_t channels = 0;
+        uint32_t rate = 0;
+        uint16_t bits = 0;
+        std::span<const uint8_t> data;
+        for (std::size_t offset = 12; offset + 8 <= file.size();)
+        {
+            const uint8_t* chunk = file.data() + offset;
+            const auto size = std::min<std::size_t>(read_le<uint32_t>(chunk + 4),
+                                                    file.size() - offset - 8);
+            if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+            {
+                format = read_le<uint16_t>(chunk + 8);
+                channels = read_le<uint16_t>(chunk + 10);
+                rate = read_le<uint32_t>(chunk + 12);
+                bits = read_le<uint16_t>(chunk + 22);
+            }
+            else if (std::memcmp(chunk, "data", 4) == 0)
+            {
+                data = file.subspan(offset + 8, size);
+            }
+            // Chunks are padded to an even size
+            offset += 8 + size + (size & 1);
+        }
+
+        constexpr uint16_t pcm = 1;
+        constexpr uint16_t ieee_float = 3;
+        const bool supported = (format == pcm && (bits == 8 || bits == 16))
+                               || (format == ieee_float && bits == 32);
+        if (!supported || channels == 0 || rate == 0) return mismatch;
+
+        const std::size_t frame_size = std::size_t{channels} * bits / 8;
+        SignalSource source{static_cast<float>(rate)};
+        source.recording.reserve(data.size() / frame_size);
+        for (std::size_t frame = 0; frame + frame_size <= data.size(); frame += frame_size)
+        {
+            float mixed = 0.F;
+            for (std::size_t channel = 0; channel < channels; ++channel)
+            {
+                const uint8_t* sample = data.data() + frame + channel * bits / 8;
+                if (format == ieee_float)
+                    mixed += read_le<float>(sample);
+                else if (bits == 16)
+                    mixed += static_cast<float>(read_le<int16_t>(sample)) / 32768.F;
+                else
+                    mixed += (static_cast<float>(*sample) - 128.F) / 128.F;
+            }
+            source.recording.push_back(mixed / channels);
+        }
+        if (source.recording.empty()) return mismatch;
+        return source;
+    }
+
+    void SignalSource::fill(std::span<uint16_t> samples)
+    {
+        constexpr float mid_scale = 1 << 11; // 12 bit samples
+        for (auto& sample : samples)
+        {
+            const float level = std::clamp(next(), -1.F, 1.F);
+            sample = static_cast<uint16_t>(std::min((level + 1.F) * mid_scale, 2 * mid_scale - 1));
+        }
+    }
+
+    auto SignalSource::next() -> float
+    {
+        constexpr double tau = 2 * std::numbers::pi;
+        if (!recording.empty())
+        {
+            const float value = recording[position];
+            position = (position + 1) % recording.size();
+            return value;
+        }
+
+        float value = 0.F;
+        phases.resize(tones.size());
+        for (std::size_t i = 0; i < tones.size(); ++i)
+        {
+            value += tones[i].level * static_cast<float>(std::sin(phases[i]));
+            phases[i] = std::fmod(phases[i] + tau * tones[i].frequency / rate, tau);
+        }
+        if (sweep)
+        {
+            const auto length = static_cast<uint64_t>(std::max(sweep->seconds * rate, 1.F));
+            const float progress = static_cast<float>(sweep_sample % length) / length;
+            const float frequency = sweep->from + (sweep->to - sweep->from) * progress;
+            value += sweep->level * static_cast<float>(std::sin(sweep_phase));
+            sweep_phase = std::fmod(sweep_phase + tau * frequency / rate, tau);
+            ++sweep_sample;
+        }
+        if (noise > 0.F)
+        {
+            std::uniform_real_distribution<float> uniform{-noise, noise};
+            value += uniform(rng);
+        }
+        return value;
+    }
+} // namespace mi
+#endif
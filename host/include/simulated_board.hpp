@@ -0,0 +1,171 @@
+#pragma once
+
+#include "batch.hpp"
+#include "bit_pack.hpp"
+#include "delta_codec.hpp"
+#include "fft.hpp"
+#include "raw_samples.hpp"
+#include "receiver.hpp"
+#include "sender.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace mi
+{
+    // The firmware's main loop without the hardware: host messages go in, encoded frames come
+    // out, with the same receiver, transform and encoders the board runs. Heartbeats keep it
+    // streaming for 3 s, StartStreamingData grants credits and StreamConfig picks the encoding,
+    // like on the board. Credits only count while the host is heard from: a grant that comes
+    // before the first heartbeat is ignored, and they lapse with the heartbeat. SetFrequencyData
+    // sets the bands the bins are squashed into, which the firmware keeps fixed at the message's
+    // defaults for now.
+    // The transform's buffers are static like on the board, so there's one simulated board per
+    // process.
+    struct SimulatedBoard
+    {
+        using Clock = std::chrono::steady_clock;
+        // Half of the board's ADC buffer, transformed whenever the DMA fills it
+        constexpr static std::size_t block_size = limits::max_samples;
+        constexpr static Clock::duration heartbeat_timeout = std::chrono::seconds{3};
+
+        SimulatedBoard() = default;
+        SimulatedBoard(const SimulatedBoard&) = delete;
+        auto operator=(const SimulatedBoard&) -> SimulatedBoard& = delete;
+
+        // Takes whatever the host wrote. A frame that fails to decode is answered with its error
+        // code as a single raw byte, which is what the firmware does.
+        void receive(std::span<const uint8_t> bytes, Clock::time_point now);
+        // The ADC filled another block, `dt` after the previous one. Returns whether a frame went
+        // out, the host may not be listening or have credits left, and a FourierBatch only goes
+        // out once it's full.
+        auto sample(std::span<const uint16_t, block_size> block, float dt, Clock::time_point now)
+            -> bool;
+
+        // Encoded bytes waiting for the wire, the caller drains them at the line rate
+        [[nodiscard]] auto outbound() -> std::vector<uint8_t>& { return pending; }
+        [[nodiscard]] auto listening(Clock::time_point now) const -> bool
+        {
+            return now < heartbeat_deadline;
+        }
+        [[nodiscard]] auto credits() const -> uint32_t { return granted; }
+
+    private:
+        struct PendingSink
+        {
+            void operator()(std::span<const uint8_t> bytes) const
+            {
+                pending->insert(pending->end(), bytes.begin(), bytes.end());
+            }
+
+            std::vector<uint8_t>* pending;
+        };
+
+        template<std::convertible_to<Message> ConcreteMessage> auto send(ConcreteMessage& message)
+            -> bool;
+
+        std::vector<uint8_t> pending;
+        Receiver<max_encoded_size<Heartbeat, SetFrequencyData, StartStreamingData, StreamConfig>>
+            receiver;
+        Sender<max_encoded_size<Message>, PendingSink> sender{PendingSink{&pending}};
+        Clock::time_point heartbeat_deadline;
+        uint32_t granted = 0;
+        StreamConfig stream_config;
+        SetFrequencyData freq_data;
+        DeltaEncoder<limits::max_bands> delta_encoder;
+        BitPacker<limits::max_bands> bit_packer;
+        BatchBuilder<limits::max_batched> batch_builder;
+        SampleEncoder<limits::max_samples> sample_encoder;
+    };
+    static_assert(SimulatedBoard::block_size / 2 <= limits::max_bands,
+                  "Spectra outgrow the Fourier messages");
+
+    template<std::convertible_to<Message> ConcreteMessage>
+    auto SimulatedBoard::send(ConcreteMessage& message) -> bool
+    {
+        if (sender.send(message).has_value()) return false;
+        --granted;
+        return true;
+    }
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <algorithm>
+#    include <variant>
+
+namespace mi
+{
+    void SimulatedBoard::receive(std::span<const uint8_t> bytes, Clock::time_point now)
+    {
+        auto on_message = [this, now](tl::expected<Message, Error> message)
+        {
+            if (!message.has_value())
+            {
+                pending.push_back(static_cast<uint8_t>(message.error()));
+                return;
+            }
+            // OverloadSet can't take capturing lambdas, the firmware gets away with globals
+            const Message& received = message.value();
+            if (std::holds_alternative<Heartbeat>(received))
+                heartbeat_deadline = now + heartbeat_timeout;
+            else if (const auto* grant = std::get_if<StartStreamingData>(&received))
+            {
+                if (listening(now))
+                    granted = std::min<uint64_t>(uint64_t{granted} + grant->number_of_datums,
+                                                 UINT32_MAX);
+            }
+            else if (const auto* config = std::get_if<StreamConfig>(&received))
+            {
+                stream_config = *config;
+                delta_encoder.keyframe_interval = config->keyframe_interval;
+                delta_encoder.force_keyframe();
+                batch_builder.batch_size = config->batch_size;
+                batch_builder.reset();
+            }
+            else if (const auto* data = std::get_if<SetFrequencyData>(&received))
+                freq_data = *data;
+        };
+        receiver.put(bytes, on_message);
+    }
+
+    auto SimulatedBoard::sample(std::span<const uint16_t, block_size> block,
+                                float dt,
+                                Clock::time_point now) -> bool
+    {
+        if (!listening(now)) granted = 0;
+        if (granted == 0) return false;
+
+        // The host runs the transform on the raw samples itself
+        if (stream_config.encoding == FrameEncoding::RAW
+            || stream_config.encoding == FrameEncoding::RAW_DELTA)
+        {
+            auto result =
+                sample_encoder.encode(block, stream_config.encoding == FrameEncoding::RAW_DELTA);
+            return result.has_value() && send(result.value());
+        }
+
+        auto fft_result = fft(block, freq_data, dt);
+        if (!fft_result.has_value()) return false;
+
+        if (stream_config.encoding == FrameEncoding::DELTA)
+        {
+            auto result = delta_encoder.encode(fft_result.value());
+            return result.has_value() && send(result.value());
+        }
+        if (stream_config.encoding == FrameEncoding::PACKED)
+        {
+            auto result = bit_packer.pack(fft_result.value(), stream_config.bits);
+            return result.has_value() && send(result.value());
+        }
+        if (stream_config.batch_size > 1)
+        {
+            auto result = batch_builder.push(fft_result.value());
+            return result.has_value() && send(result.value());
+        }
+        FourierData result{fft_result.value()};
+        return send(result);
+    }
+} // namespace mi
+#endif
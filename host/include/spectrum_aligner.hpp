@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace mi
+{
+    // Lines up the spectra of several sources by the time they were read. Every source keeps its
+    // newest spectrum, and once each open source has delivered one since the last combination,
+    // their newest spectra are concatenated in source order into a single spectrum, stamped with
+    // the latest read among them. A source that streams faster than the others only contributes
+    // its newest spectrum, so the parts of a combination are never further apart than one period
+    // of the slowest source. A source that stays silent for `silence` drops out of the
+    // combinations until it speaks again, so it can't hold the others up for good.
+    struct SpectrumAligner
+    {
+        using Clock = std::chrono::steady_clock;
+
+        SpectrumAligner(std::size_t sources, Clock::duration silence_) :
+            parts(sources), silence{silence_}
+        {
+        }
+
+        // Calls `handler` with the read time and the amplitudes of the combination the spectrum
+        // completes, if any. The amplitudes view the aligner's buffer and are only valid until
+        // the handler returns.
+        template<typename Handler>
+        void put(std::size_t source, Clock::time_point read_at,
+                 std::span<const uint8_t> amplitudes, Handler&& handler);
+        // A closed source no longer holds the others up and drops out of the combinations
+        void close(std::size_t source) { parts[source].open = false; }
+
+        [[nodiscard]] auto combined() const -> uint64_t { return combined_count; }
+        // Spectra replaced by a newer one of the same source before they made it into a
+        // combination
+        [[nodiscard]] auto superseded() const -> uint64_t { return superseded_count; }
+
+    private:
+        struct Part
+        {
+            std::vector<uint8_t> amplitudes;
+            Clock::time_point read_at;
+            bool fresh = false;
+            bool open = true;
+        };
+
+        std::vector<Part> parts;
+        Clock::duration silence;
+        bool started = false;
+        std::vector<uint8_t> combination;
+        uint64_t combined_count = 0;
+        uint64_t superseded_count = 0;
+    };
+
+    template<typename Handler>
+    void SpectrumAligner::put(std::size_t source, Clock::time_point read_at,
+                              std::span<const uint8_t> amplitudes, Handler&& handler)
+    {
+        // Sources not heard from yet count as silent from the first spectrum on
+        if (!started)
+        {
+            for (Part& other : parts)
+                other.read_at = read_at;
+            started = true;
+        }
+
+        Part& part = parts[source];
+        if (part.fresh) ++superseded_count;
+        // Keeps its capacity, so steady spectra allocate nothing once warmed up
+        part.amplitudes.assign(amplitudes.begin(), amplitudes.end());
+        part.read_at = read_at;
+        part.fresh = true;
+
+        Clock::time_point now = read_at;
+        for (const Part& other : parts)
+            now = std::max(now, other.read_at);
+        auto silent = [&](const Part& other) { return now - other.read_at >= silence; };
+        for (const Part& other : parts)
+        {
+            if (other.open && !other.fresh && !silent(other)) return;
+        }
+
+        Clock::time_point latest = read_at;
+        combination.clear();
+        for (Part& other : parts)
+        {
+            if (!other.open || silent(other)) continue;
+            combination.insert(combination.end(), other.amplitudes.begin(), other.amplitudes.end());
+            latest = std::max(latest, other.read_at);
+            other.fresh = false;
+        }
+        ++combined_count;
+        handler(latest, std::span<const uint8_t>{combination});
+    }
+} // namespace mi
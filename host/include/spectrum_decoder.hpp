@@ -0,0 +1,78 @@
+#pragma once
+
+#include "bit_pack.hpp"
+#include "delta_codec.hpp"
+#include "message_definitions.hpp"
+#include "raw_samples.hpp"
+#include "stft.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <variant>
+
+namespace mi
+{
+    // Turns every flavour of spectrum message back into plain amplitudes, whichever encoding
+    // the board streams in. Raw samples go through a 4096 point transform with 75% overlap,
+    // eight times the resolution the board can afford, restarted whenever a block goes missing.
+    struct SpectrumDecoder
+    {
+        constexpr static std::size_t stft_size = 4096;
+        // The widest spectrum handed out, the transform of raw samples outgrows the board's
+        constexpr static std::size_t max_bands = std::max(stft_size / 2, limits::max_bands);
+
+        // Calls `handler` with each spectrum in the message, the spectrum views the decoder's
+        // buffers and is only valid until the handler returns
+        template<typename Handler>
+        [[nodiscard]] auto decode(const Message& message, Handler&& handler)
+            -> std::optional<Error>;
+
+    private:
+        DeltaDecoder<limits::max_bands> delta_decoder;
+        BitUnpacker<limits::max_bands> bit_unpacker;
+        SampleDecoder<limits::max_samples> sample_decoder;
+        Stft<stft_size> stft{stft_size / 4};
+        std::optional<uint8_t> expected_seq;
+    };
+
+    template<typename Handler>
+    auto SpectrumDecoder::decode(const Message& message, Handler&& handler) -> std::optional<Error>
+    {
+        if (const auto* data = std::get_if<FourierData>(&message))
+        {
+            handler(std::span<const uint8_t>{data->amplitudes});
+        }
+        else if (const auto* delta = std::get_if<FourierDelta>(&message))
+        {
+            auto decoded = delta_decoder.decode(*delta);
+            if (!decoded.has_value()) return decoded.error();
+            handler(std::span<const uint8_t>{decoded.value()});
+        }
+        else if (const auto* packed = std::get_if<PackedFourierData>(&message))
+        {
+            auto unpacked = bit_unpacker.unpack(*packed);
+            if (!unpacked.has_value()) return unpacked.error();
+            handler(std::span<const uint8_t>{unpacked.value()});
+        }
+        else if (const auto* batch = std::get_if<FourierBatch>(&message))
+        {
+            for (auto spectrum : batch->spectra())
+                handler(std::span<const uint8_t>{spectrum});
+        }
+        else if (const auto* raw = std::get_if<RawSamples>(&message))
+        {
+            auto samples = sample_decoder.decode(*raw);
+            if (!samples.has_value()) return samples.error();
+            // Windows must not straddle a lost block
+            if (expected_seq.has_value() && raw->seq() != expected_seq.value()) stft.reset();
+            expected_seq = raw->seq() + 1;
+            stft.push(samples.value(), handler);
+        }
+        else
+        {
+            return Error::UNKNOWN_MSG_ID;
+        }
+        return std::nullopt;
+    }
+} // namespace mi
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace mi
+{
+#pragma pack(push, 1)
+    // Binary spectrum stream between the host tools. Every spectrum is this header followed by
+    // `bands` amplitudes. The timestamp is the steady clock reading of when the spectrum's bytes
+    // came off the link, in nanoseconds, so any process on the same machine can measure latency.
+    struct SpectrumRecord
+    {
+        uint64_t timestamp_ns;
+        uint16_t bands;
+    };
+#pragma pack(pop)
+
+    inline void append_record(std::vector<uint8_t>& out,
+                              std::chrono::steady_clock::time_point read_at,
+                              std::span<const uint8_t> amplitudes)
+    {
+        const SpectrumRecord record{
+            .timestamp_ns = static_cast<uint64_t>(
+                std::chrono::nanoseconds{read_at.time_since_epoch()}.count()),
+            .bands = static_cast<uint16_t>(amplitudes.size()),
+        };
+        const auto* header = reinterpret_cast<const uint8_t*>(&record);
+        out.insert(out.end(), header, header + sizeof(record));
+        out.insert(out.end(), amplitudes.begin(), amplitudes.end());
+    }
+
+    struct SpectrumRecordReader
+    {
+        // Calls `handler` with the timestamp and amplitudes of every record completed by the
+        // bytes, a record split between two reads is kept until its remainder arrives
+        template<typename Handler> void put(std::span<const uint8_t> bytes, Handler&& handler);
+
+    private:
+        template<typename Handler>
+        static auto parse(std::span<const uint8_t> bytes, Handler& handler) -> std::size_t;
+
+        std::vector<uint8_t> partial;
+    };
+
+    template<typename Handler>
+    void SpectrumRecordReader::put(std::span<const uint8_t> bytes, Handler&& handler)
+    {
+        if (partial.empty())
+        {
+            const std::size_t consumed = parse(bytes, handler);
+            partial.assign(bytes.begin() + consumed, bytes.end());
+            return;
+        }
+        partial.insert(partial.end(), bytes.begin(), bytes.end());
+        const std::size_t consumed = parse(partial, handler);
+        partial.erase(partial.begin(), partial.begin() + consumed);
+    }
+
+    template<typename Handler>
+    auto SpectrumRecordReader::parse(std::span<const uint8_t> bytes, Handler& handler)
+        -> std::size_t
+    {
+        std::size_t at = 0;
+        SpectrumRecord record;
+        while (bytes.size() - at >= sizeof(record))
+        {
+            std::memcpy(&record, bytes.data() + at, sizeof(record));
+            if (bytes.size() - at - sizeof(record) < record.bands) break;
+            const std::chrono::steady_clock::time_point read_at{
+                std::chrono::nanoseconds{record.timestamp_ns}};
+            handler(read_at, bytes.subspan(at + sizeof(record), record.bands));
+            at += sizeof(record) + record.bands;
+        }
+        return at;
+    }
+} // namespace mi
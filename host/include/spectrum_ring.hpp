@@ -0,0 +1,304 @@
+#pragma once
+
+#include "mapping.hpp"
+#include "message_definitions.hpp"
+#include "spectrum_decoder.hpp"
+#include "tl-expected.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace mi
+{
+    // Shared memory transport for decoded spectra. One writer fills a ring of fixed size slots,
+    // any number of readers map the same memory read only and pick up the newest complete slot
+    // without a system call. Every slot is a seqlock: its sequence is odd while the writer is in
+    // it, so a reader that raced a write notices and tries again. A reader that falls behind only
+    // ever misses stale spectra, it can never hold the writer up. The writer picks how wide the
+    // slots are and records it in the header, readers size themselves from that.
+    namespace ring
+    {
+        constexpr static uint32_t magic = 0x4D495247; // "MIRG", Mi RinG
+        constexpr static uint32_t version = 3;
+        constexpr static uint32_t min_slots = 2;
+        // Slot width unless the writer asks for another, any spectrum the decoder produces fits
+        constexpr static uint32_t default_max_bands = SpectrumDecoder::max_bands;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slots;
+            uint32_t max_bands;
+            // Spectra published so far, the newest one lives in slot (published - 1) % slots
+            alignas(64) std::atomic<uint64_t> published;
+        };
+
+        // Followed by room for `max_bands` amplitudes, up to the next slot
+        struct alignas(64) Slot
+        {
+            // 2n + 1 while spectrum n is being written, 2n + 2 once it is complete
+            std::atomic<uint64_t> sequence;
+            uint64_t timestamp_ns;
+            uint32_t bands;
+        };
+        static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                      "Atomics in shared memory must not hide a lock");
+
+        [[nodiscard]] constexpr auto slot_size(uint32_t max_bands) -> std::size_t
+        {
+            return (sizeof(Slot) + max_bands + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+        }
+
+        [[nodiscard]] constexpr auto mapping_size(uint32_t slots, uint32_t max_bands) -> std::size_t
+        {
+            return sizeof(Header) + std::size_t{slots} * slot_size(max_bands);
+        }
+
+        [[nodiscard]] inline auto header(const Mapping& memory) -> Header*
+        {
+            return reinterpret_cast<Header*>(memory.data());
+        }
+
+        [[nodiscard]] inline auto slot(const Mapping& memory, uint64_t index) -> Slot*
+        {
+            const Header& ring = *header(memory);
+            const std::size_t offset = index % ring.slots * slot_size(ring.max_bands);
+            return reinterpret_cast<Slot*>(memory.data() + sizeof(Header) + offset);
+        }
+
+        [[nodiscard]] inline auto amplitudes(Slot& slot) -> uint8_t*
+        {
+            return reinterpret_cast<uint8_t*>(&slot + 1);
+        }
+    } // namespace ring
+
+    struct SpectrumRingWriter
+    {
+        // Creates the ring as POSIX shared memory called `name`, "/mi_spectrum" for example, in
+        // place of any older ring of that name. Readers still mapping the old one keep it until
+        // they let go. Without a name the ring is an anonymous memfd, shared by passing on `fd`.
+        // Spectra wider than `max_bands` are refused.
+        [[nodiscard]] static auto create(const char* name,
+                                         uint32_t slots = 8,
+                                         uint32_t max_bands = ring::default_max_bands)
+            -> tl::expected<SpectrumRingWriter, std::error_code>;
+
+        SpectrumRingWriter(SpectrumRingWriter&& other) noexcept;
+        auto operator=(SpectrumRingWriter&& other) noexcept -> SpectrumRingWriter&;
+        SpectrumRingWriter(const SpectrumRingWriter&) = delete;
+        auto operator=(const SpectrumRingWriter&) -> SpectrumRingWriter& = delete;
+        // Unlinks the name, so readers can't attach to a ring nobody writes any more
+        ~SpectrumRingWriter();
+
+        [[nodiscard]] auto publish(std::chrono::steady_clock::time_point read_at,
+                                   std::span<const uint8_t> amplitudes) -> std::optional<Error>;
+        [[nodiscard]] auto fd() const -> int { return descriptor; }
+
+    private:
+        SpectrumRingWriter(Mapping memory_, int descriptor_, std::string name_) :
+            memory{std::move(memory_)}, descriptor{descriptor_}, name{std::move(name_)}
+        {
+        }
+
+        Mapping memory;
+        int descriptor;
+        std::string name;
+        uint64_t published = 0;
+    };
+
+    struct SpectrumRingReader
+    {
+        [[nodiscard]] static auto attach(const char* name)
+            -> tl::expected<SpectrumRingReader, std::error_code>;
+        // Maps the ring behind `fd`, which may be closed afterwards
+        [[nodiscard]] static auto attach(int fd)
+            -> tl::expected<SpectrumRingReader, std::error_code>;
+
+        // Calls `handler` with the timestamp and amplitudes of the newest spectrum, if one was
+        // published since the last call, and returns whether it did. The amplitudes view the
+        // reader's copy and are valid until the next call.
+        template<typename Handler> auto latest(Handler&& handler) -> bool;
+        // Spectra published but replaced before this reader got to them
+        [[nodiscard]] auto skipped() const -> uint64_t { return skipped_count; }
+
+    private:
+        SpectrumRingReader(Mapping memory_, uint32_t max_bands) :
+            memory{std::move(memory_)}, amplitudes(max_bands)
+        {
+        }
+
+        Mapping memory;
+        uint64_t seen = 0;
+        uint64_t skipped_count = 0;
+        // As wide as the ring's slots
+        std::vector<uint8_t> amplitudes;
+    };
+
+    template<typename Handler> auto SpectrumRingReader::latest(Handler&& handler) -> bool
+    {
+        // Each retry means the writer lapped the slot mid copy, a few are plenty
+        constexpr int max_attempts = 4;
+        for (int attempt = 0; attempt < max_attempts; ++attempt)
+        {
+            const uint64_t published =
+                ring::header(memory)->published.load(std::memory_order_acquire);
+            if (published == seen) return false;
+
+            ring::Slot& slot = *ring::slot(memory, published - 1);
+            const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            if (before != 2 * published) continue;
+            const uint64_t timestamp_ns = slot.timestamp_ns;
+            const std::size_t bands = std::min<std::size_t>(slot.bands, amplitudes.size());
+            std::memcpy(amplitudes.data(), ring::amplitudes(slot), bands);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != before) continue;
+
+            skipped_count += published - seen - 1;
+            seen = published;
+            const std::chrono::steady_clock::time_point read_at{
+                std::chrono::nanoseconds{timestamp_ns}};
+            handler(read_at, std::span<const uint8_t>{amplitudes.data(), bands});
+            return true;
+        }
+        return false;
+    }
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <cerrno>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#    include <utility>
+
+namespace mi
+{
+    auto SpectrumRingWriter::create(const char* name, uint32_t slots, uint32_t max_bands)
+        -> tl::expected<SpectrumRingWriter, std::error_code>
+    {
+        auto error = []()
+        { return tl::unexpected{std::error_code{errno, std::generic_category()}}; };
+        if (slots < ring::min_slots || max_bands == 0)
+            return tl::unexpected{std::make_error_code(std::errc::invalid_argument)};
+
+        int descriptor;
+        if (name != nullptr)
+        {
+            // Unlinking first leaves the readers of an older ring a consistent, if final, view
+            shm_unlink(name);
+            descriptor = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        }
+        else
+        {
+            descriptor = memfd_create("mi_spectrum", MFD_CLOEXEC);
+        }
+        if (descriptor < 0) return error();
+
+        const std::size_t size = ring::mapping_size(slots, max_bands);
+        void* address = MAP_FAILED;
+        if (ftruncate(descriptor, static_cast<off_t>(size)) == 0)
+            address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (address == MAP_FAILED)
+        {
+            auto failure = error();
+            close(descriptor);
+            if (name != nullptr) shm_unlink(name);
+            return failure;
+        }
+
+        // ftruncate zero fills, so every sequence and the published count start out at 0
+        Mapping memory{address, size};
+        ring::Header& header = *ring::header(memory);
+        header.slots = slots;
+        header.max_bands = max_bands;
+        header.version = ring::version;
+        std::atomic_ref{header.magic}.store(ring::magic, std::memory_order_release);
+        return SpectrumRingWriter{std::move(memory), descriptor, name != nullptr ? name : ""};
+    }
+
+    SpectrumRingWriter::SpectrumRingWriter(SpectrumRingWriter&& other) noexcept :
+        memory{std::move(other.memory)},
+        descriptor{std::exchange(other.descriptor, -1)},
+        name{std::exchange(other.name, {})},
+        published{other.published}
+    {
+    }
+
+    auto SpectrumRingWriter::operator=(SpectrumRingWriter&& other) noexcept -> SpectrumRingWriter&
+    {
+        std::swap(memory, other.memory);
+        std::swap(descriptor, other.descriptor);
+        std::swap(name, other.name);
+        std::swap(published, other.published);
+        return *this;
+    }
+
+    SpectrumRingWriter::~SpectrumRingWriter()
+    {
+        if (!name.empty()) shm_unlink(name.c_str());
+        if (descriptor >= 0) close(descriptor);
+    }
+
+    auto SpectrumRingWriter::publish(std::chrono::steady_clock::time_point read_at,
+                                     std::span<const uint8_t> amplitudes) -> std::optional<Error>
+    {
+        if (amplitudes.size() > ring::header(memory)->max_bands) return Error::OUT_OF_MEMORY;
+
+        ring::Slot& slot = *ring::slot(memory, published);
+        slot.sequence.store(2 * published + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp_ns =
+            static_cast<uint64_t>(std::chrono::nanoseconds{read_at.time_since_epoch()}.count());
+        slot.bands = static_cast<uint32_t>(amplitudes.size());
+        std::memcpy(ring::amplitudes(slot), amplitudes.data(), amplitudes.size());
+        slot.sequence.store(2 * published + 2, std::memory_order_release);
+        ring::header(memory)->published.store(++published, std::memory_order_release);
+        return std::nullopt;
+    }
+
+    auto SpectrumRingReader::attach(const char* name)
+        -> tl::expected<SpectrumRingReader, std::error_code>
+    {
+        const int descriptor = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+        if (descriptor < 0) return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        auto reader = attach(descriptor);
+        close(descriptor);
+        return reader;
+    }
+
+    auto SpectrumRingReader::attach(int fd) -> tl::expected<SpectrumRingReader, std::error_code>
+    {
+        const auto mismatch = tl::unexpected{std::make_error_code(std::errc::wrong_protocol_type)};
+        struct stat status;
+        if (fstat(fd, &status) < 0)
+            return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        if (static_cast<std::size_t>(status.st_size) < sizeof(ring::Header)) return mismatch;
+
+        const auto size = static_cast<std::size_t>(status.st_size);
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+            return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        Mapping memory{address, size};
+
+        ring::Header& header = *ring::header(memory);
+        // The magic is stored last, a ring caught half initialised reads as a mismatch
+        const uint32_t magic = std::atomic_ref{header.magic}.load(std::memory_order_acquire);
+        if (magic != ring::magic || header.version != ring::version || header.max_bands == 0
+            || header.slots < ring::min_slots
+            || size < ring::mapping_size(header.slots, header.max_bands))
+            return mismatch;
+        const uint32_t max_bands = header.max_bands;
+        return SpectrumRingReader{std::move(memory), max_bands};
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#define __USE_SQUARE_BRACKETS_FOR_ELEMENT_ACCESS_OPERATOR
+#include "simple_fft/fft.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <numbers>
+#include <span>
+
+namespace mi
+{
+    // Short time Fourier transform over the raw sample stream, for windows far longer than the
+    // board can afford. Every `hop` samples the last `WindowSize` ones are Hann windowed and
+    // transformed, and the magnitude of each of the `WindowSize / 2` bands is log scaled to a
+    // byte, a full scale sine being full scale.
+    template<std::size_t WindowSize> struct Stft
+    {
+        static_assert(std::has_single_bit(WindowSize), "The transform needs a power of two");
+
+        explicit Stft(std::size_t hop_ = WindowSize / 4);
+
+        // Calls `handler` with every spectrum completed by the samples, the spectrum views the
+        // transform's buffer and is only valid until the handler returns
+        template<typename Handler> void push(std::span<const uint16_t> samples, Handler&& handler);
+        // Forgets the samples seen so far, for when the stream has a gap
+        void reset()
+        {
+            filled = 0;
+            since_transform = 0;
+        }
+
+        const std::size_t hop;
+
+    private:
+        void transform();
+
+        std::array<float, WindowSize> hann;
+        std::array<float, WindowSize> history;
+        std::array<float, WindowSize> windowed;
+        std::array<std::complex<float>, WindowSize> spectrum;
+        std::array<uint8_t, WindowSize / 2> bands;
+        std::size_t head = 0;
+        std::size_t filled = 0;
+        std::size_t since_transform = 0;
+    };
+
+    template<std::size_t WindowSize>
+    Stft<WindowSize>::Stft(std::size_t hop_) : hop{std::clamp<std::size_t>(hop_, 1, WindowSize)}
+    {
+        for (std::size_t i = 0; i < WindowSize; ++i)
+        {
+            const float t = static_cast<float>(i) / (WindowSize - 1);
+            hann[i] = 0.5F - 0.5F * std::cos(2 * std::numbers::pi_v<float> * t);
+        }
+    }
+
+    template<std::size_t WindowSize>
+    template<typename Handler>
+    void Stft<WindowSize>::push(std::span<const uint16_t> samples, Handler&& handler)
+    {
+        constexpr float mid_scale = 1 << 11; // 12 bit samples
+        for (auto sample : samples)
+        {
+            history[head] = static_cast<float>(sample) / mid_scale - 1.F;
+            head = (head + 1) % WindowSize;
+            filled = std::min(filled + 1, WindowSize);
+            if (++since_transform < hop || filled < WindowSize) continue;
+
+            since_transform = 0;
+            transform();
+            handler(std::span<const uint8_t>{bands});
+        }
+    }
+
+    template<std::size_t WindowSize> void Stft<WindowSize>::transform()
+    {
+        for (std::size_t i = 0; i < WindowSize; ++i)
+            windowed[i] = history[(head + i) % WindowSize] * hann[i];
+
+        const char* error = nullptr;
+        simple_fft::FFT(windowed, spectrum, WindowSize, error);
+
+        // A full scale sine peaks at a quarter of the window once the Hann window is applied
+        const float full_scale = std::log1p(static_cast<float>(WindowSize) / 4);
+        for (std::size_t k = 0; k < bands.size(); ++k)
+        {
+            const float level = std::log1p(std::abs(spectrum[k])) / full_scale;
+            bands[k] = static_cast<uint8_t>(std::clamp(level, 0.F, 1.F) * UINT8_MAX);
+        }
+    }
+} // namespace mi
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace mi
+{
+    template<typename T = void> struct Task;
+
+    namespace detail
+    {
+        struct PromiseBase
+        {
+            // Hands control straight back to whoever awaited the task, without growing the stack
+            struct FinalAwaiter
+            {
+                [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+                template<typename Promise>
+                auto await_suspend(std::coroutine_handle<Promise> done) noexcept
+                    -> std::coroutine_handle<>
+                {
+                    return done.promise().continuation;
+                }
+                void await_resume() const noexcept {}
+            };
+
+            auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+            auto final_suspend() noexcept -> FinalAwaiter { return {}; }
+            // The host code doesn't throw, an escaping exception is a bug
+            void unhandled_exception() { std::terminate(); }
+
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+        };
+
+        template<typename T> struct Promise : PromiseBase
+        {
+            void return_value(T result) { value.emplace(std::move(result)); }
+
+            std::optional<T> value;
+        };
+
+        template<> struct Promise<void> : PromiseBase
+        {
+            void return_void() {}
+        };
+
+        struct Detached
+        {
+            struct promise_type
+            {
+                auto get_return_object() -> Detached { return {}; }
+                auto initial_suspend() noexcept -> std::suspend_never { return {}; }
+                auto final_suspend() noexcept -> std::suspend_never { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+    } // namespace detail
+
+    // A coroutine that starts once awaited and resumes its awaiter when it co_returns
+    template<typename T> struct Task
+    {
+        struct promise_type : detail::Promise<T>
+        {
+            auto get_return_object() -> Task
+            {
+                return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+        };
+
+        Task(Task&& other) noexcept : handle{std::exchange(other.handle, nullptr)} {}
+        auto operator=(Task&& other) noexcept -> Task&
+        {
+            std::swap(handle, other.handle);
+            return *this;
+        }
+        Task(const Task&) = delete;
+        auto operator=(const Task&) -> Task& = delete;
+        ~Task()
+        {
+            if (handle) handle.destroy();
+        }
+
+        [[nodiscard]] auto await_ready() const noexcept -> bool { return false; }
+        auto await_suspend(std::coroutine_handle<> awaiting) noexcept -> std::coroutine_handle<>
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+        auto await_resume() -> T
+        {
+            if constexpr (!std::is_void_v<T>) return std::move(*handle.promise().value);
+        }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle_) : handle{handle_} {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    namespace detail
+    {
+        inline auto detach(Task<void> task) -> Detached { co_await task; }
+    } // namespace detail
+
+    // Starts `task` right away and lets it run to completion on its own, whatever it waits for
+    // along the way resumes it from the event loop
+    inline void spawn(Task<void> task) { detail::detach(std::move(task)); }
+} // namespace mi
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "tl-expected.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <system_error>
+
+namespace mi
+{
+    // Periodic timerfd, to be watched by an event loop next to the links it paces. The first
+    // expiry is one interval after creation. An interval of 0 leaves it disarmed.
+    struct Timer
+    {
+        [[nodiscard]] static auto create(std::chrono::nanoseconds interval)
+            -> tl::expected<Timer, std::error_code>;
+
+        Timer(Timer&& other) noexcept;
+        auto operator=(Timer&& other) noexcept -> Timer&;
+        Timer(const Timer&) = delete;
+        auto operator=(const Timer&) -> Timer& = delete;
+        ~Timer();
+
+        // Fires once after `delay` instead, a delay of 0 disarms the timer
+        [[nodiscard]] auto schedule(std::chrono::nanoseconds delay)
+            -> std::optional<std::error_code>;
+        // How often the timer expired since the last call, 0 if it hasn't yet
+        [[nodiscard]] auto expirations() -> uint64_t;
+        [[nodiscard]] auto fd() const -> int { return descriptor; }
+
+    private:
+        explicit Timer(int descriptor_) : descriptor{descriptor_} {}
+
+        int descriptor;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <cerrno>
+#    include <sys/timerfd.h>
+#    include <unistd.h>
+#    include <utility>
+
+namespace mi
+{
+    namespace
+    {
+        auto to_timespec(std::chrono::nanoseconds duration) -> timespec
+        {
+            const auto seconds = std::chrono::floor<std::chrono::seconds>(duration);
+            return {
+                .tv_sec = static_cast<time_t>(seconds.count()),
+                .tv_nsec = static_cast<long>((duration - seconds).count()),
+            };
+        }
+    } // namespace
+
+    auto Timer::create(std::chrono::nanoseconds interval) -> tl::expected<Timer, std::error_code>
+    {
+        const int descriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (descriptor < 0) return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        Timer timer{descriptor};
+
+        const itimerspec periodic{.it_interval = to_timespec(interval),
+                                  .it_value = to_timespec(interval)};
+        if (timerfd_settime(descriptor, 0, &periodic, nullptr) < 0)
+            return tl::unexpected{std::error_code{errno, std::generic_category()}};
+        return timer;
+    }
+
+    auto Timer::schedule(std::chrono::nanoseconds delay) -> std::optional<std::error_code>
+    {
+        const itimerspec once{.it_interval = {}, .it_value = to_timespec(delay)};
+        if (timerfd_settime(descriptor, 0, &once, nullptr) < 0)
+            return std::error_code{errno, std::generic_category()};
+        return std::nullopt;
+    }
+
+    Timer::Timer(Timer&& other) noexcept : descriptor{std::exchange(other.descriptor, -1)} {}
+
+    auto Timer::operator=(Timer&& other) noexcept -> Timer&
+    {
+        std::swap(descriptor, other.descriptor);
+        return *this;
+    }
+
+    Timer::~Timer()
+    {
+        if (descriptor >= 0) close(descriptor);
+    }
+
+    auto Timer::expirations() -> uint64_t
+    {
+        uint64_t count = 0;
+        while (read(descriptor, &count, sizeof(count)) < 0 && errno == EINTR)
+            ;
+        return count;
+    }
+} // namespace mi
+#endif
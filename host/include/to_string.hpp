@@ -31,6 +31,51 @@ namespace mi
                     return fmt::format("FourierData(.amplitudes = {})",
                                        fmt::join(data.amplitudes, ", "));
                 },
+                [](StreamConfig config) -> std::string
+                {
+                    return fmt::format("StreamConfig(.encoding = {}, .keyframe_interval = {}, "
+                                       ".bits = {}, .batch_size = {})",
+                                       static_cast<uint32_t>(config.encoding),
+                                       config.keyframe_interval,
+                                       config.bits,
+                                       config.batch_size);
+                },
+                [](FourierDelta delta) -> std::string
+                {
+                    return fmt::format(
+                        "FourierDelta(.seq = {}, .keyframe = {}, .bands = {}, .packed = {})",
+                        delta.seq(),
+                        delta.keyframe(),
+                        delta.bands(),
+                        fmt::join(delta.packed(), ", "));
+                },
+                [](PackedFourierData data) -> std::string
+                {
+                    return fmt::format("PackedFourierData(.bits = {}, .bands = {}, .packed = {})",
+                                       data.bits(),
+                                       data.bands(),
+                                       fmt::join(data.packed(), ", "));
+                },
+                [](FourierBatch batch) -> std::string
+                {
+                    return fmt::format("FourierBatch(.count = {}, .bands = {}, .spectra = [{}])",
+                                       batch.count(),
+                                       batch.bands(),
+                                       fmt::join(batch.spectra()
+                                                     | std::views::transform(
+                                                         [](std::span<uint8_t> spectrum)
+                                                         { return fmt::join(spectrum, ", "); }),
+                                                 "], ["));
+                },
+                [](RawSamples samples) -> std::string
+                {
+                    return fmt::format(
+                        "RawSamples(.seq = {}, .coding = {}, .count = {}, .coded = {})",
+                        samples.seq(),
+                        samples.coding(),
+                        samples.count(),
+                        fmt::join(samples.coded(), ", "));
+                },
                 [](auto other) -> std::string { return "Unknown"; },
             },
             message);
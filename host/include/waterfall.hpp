@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mi
+{
+    // Scrolling spectrogram: every spectrum becomes a row of coloured cells, the newest at the
+    // bottom. The rows live in a ring of fixed capacity, a new row taking the oldest one's slot,
+    // so the history is never moved or reallocated. On the terminal the rows sit in a scroll
+    // region: a new row scrolls the region up a line and only that row gets written, however
+    // tall the history.
+    struct Waterfall
+    {
+        // From quiet to loud: black, blue, magenta, red, yellow, white, as 256 colour indices
+        constexpr static std::array<uint8_t, 26> palette{
+            16,  17,  18,  19,  20,  21,  57,  93,  129, 165, 201, 200, 199,
+            198, 197, 196, 202, 208, 214, 220, 226, 227, 228, 229, 230, 231,
+        };
+
+        explicit Waterfall(std::size_t capacity_) : rows_capacity{capacity_} {}
+
+        // Adds a row, `levels` relative to `full_scale`. A row that's wider or narrower than the
+        // ones before starts the history over.
+        void push(std::span<const float> levels, float full_scale);
+        // Appends what brings the terminal up to date to `out`: the rows pushed since the last
+        // draw scrolled in at the bottom, or everything when the terminal doesn't show the
+        // history yet. The waterfall takes up `capacity` rows from row `top`, counted from 0.
+        void draw(std::size_t top, std::string& out);
+        // Something else wrote to the terminal, the next draw redraws everything
+        void invalidate() { redraw = true; }
+        // Appends the escape that gives scrolling back to the whole terminal
+        static void release(std::string& out) { out += "\x1b[r"; }
+
+        // Palette indices of a row, 0 being the newest
+        [[nodiscard]] auto row(std::size_t age) const -> std::span<const uint8_t>;
+        [[nodiscard]] auto size() const -> std::size_t { return count; }
+        [[nodiscard]] auto capacity() const -> std::size_t { return rows_capacity; }
+        [[nodiscard]] auto width() const -> std::size_t { return row_width; }
+
+    private:
+        void draw_row(std::size_t line, std::size_t age, std::string& out) const;
+
+        std::size_t rows_capacity;
+        std::size_t row_width = 0;
+        std::vector<uint8_t> cells;
+        // Slot of the newest row
+        std::size_t newest = 0;
+        std::size_t count = 0;
+        // Rows pushed since the last draw
+        std::size_t unshown = 0;
+        bool redraw = true;
+        std::size_t shown_top = 0;
+    };
+} // namespace mi
+
+#ifdef MI_IMPLEMENT
+#    include <algorithm>
+#    include <charconv>
+
+namespace mi
+{
+    namespace
+    {
+        void append_number(std::string& out, std::size_t number)
+        {
+            std::array<char, 20> digits;
+            out.append(digits.data(), std::to_chars(digits.begin(), digits.end(), number).ptr);
+        }
+    } // namespace
+
+    void Waterfall::push(std::span<const float> levels, float full_scale)
+    {
+        if (rows_capacity == 0) return;
+        if (levels.size() != row_width || cells.empty())
+        {
+            row_width = levels.size();
+            cells.assign(rows_capacity * row_width, 0);
+            count = 0;
+            redraw = true;
+        }
+        newest = (newest + 1) % rows_capacity;
+        count = std::min(count + 1, rows_capacity);
+        ++unshown;
+
+        constexpr auto top = static_cast<float>(palette.size() - 1);
+        uint8_t* slot = cells.data() + newest * row_width;
+        for (auto level : levels)
+        {
+            const float shade = level / full_scale * top + 0.5F;
+            // NaN lands on the quietest colour too
+            *slot++ = shade >= 1.F ? static_cast<uint8_t>(std::min(shade, top)) : 0;
+        }
+    }
+
+    auto Waterfall::row(std::size_t age) const -> std::span<const uint8_t>
+    {
+        const std::size_t slot = (newest + rows_capacity - age) % rows_capacity;
+        return {cells.data() + slot * row_width, row_width};
+    }
+
+    void Waterfall::draw(std::size_t top, std::string& out)
+    {
+        if (rows_capacity == 0) return;
+        if (redraw || top != shown_top || unshown >= rows_capacity)
+        {
+            // Confining scrolling to the region also moves the cursor, so it goes first
+            out += "\x1b[0m\x1b[";
+            append_number(out, top + 1);
+            out += ';';
+            append_number(out, top + rows_capacity);
+            out += 'r';
+            for (std::size_t line = 0; line < rows_capacity; ++line)
+                draw_row(top + line, rows_capacity - 1 - line, out);
+        }
+        else if (unshown > 0)
+        {
+            // The region scrolls in the default colour once the colours are reset
+            out += "\x1b[0m\x1b[";
+            append_number(out, unshown);
+            out += 'S';
+            for (std::size_t age = unshown; age-- > 0;)
+                draw_row(top + rows_capacity - 1 - age, age, out);
+        }
+        out += "\x1b[0m";
+        redraw = false;
+        shown_top = top;
+        unshown = 0;
+    }
+
+    void Waterfall::draw_row(std::size_t line, std::size_t age, std::string& out) const
+    {
+        out += "\x1b[";
+        append_number(out, line + 1);
+        out += ";1H\x1b[0m\x1b[2K";
+        if (age >= count) return;
+
+        // Runs of a colour share one escape
+        int colour = -1;
+        for (auto shade : row(age))
+        {
+            if (palette[shade] != colour)
+            {
+                colour = palette[shade];
+                out += "\x1b[48;5;";
+                append_number(out, colour);
+                out += 'm';
+            }
+            out += ' ';
+        }
+    }
+} // namespace mi
+#endif
@@ -0,0 +1,217 @@
+#define MI_IMPLEMENT
+#include "bars.hpp"
+#include "event_loop.hpp"
+#include "fd_sink.hpp"
+#include "link.hpp"
+#include "screen.hpp"
+#include "session.hpp"
+#include "spectrum_decoder.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <fmt/format.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <vector>
+
+using Clock = mi::Link::Clock;
+
+struct
+{
+    mi::ScaleOptions scale;
+    uint32_t baud = 115200;
+    uint32_t window = 32;
+    unsigned fps = 60;
+    const char* device = nullptr;
+} args;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void help(std::string_view program)
+{
+    std::cout << "Example Usage: " << program
+              << " [options] [DEVICE]\n"
+                 "Reads frames from DEVICE, or from stdin without one, and draws the latest\n"
+                 "spectrum continuously.\n"
+                 "Options:\n"
+                 "  -l, --lines <lines>  Number of lines to display\n"
+                 "  --max <max>          Maximum value\n"
+                 "  --min <min>          Minimum value\n"
+                 "  -b, --baud <baud>    Baud rate of the device\n"
+                 "  -w, --window <n>     Frames the board may send ahead of the display\n"
+                 "  --fps <fps>          Redraws per second at most\n"
+                 "  --help               Display this message\n";
+    exit(EXIT_FAILURE);
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for " << arg << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+        if (arg == "-l" || arg == "--lines")
+            args.scale.lines = std::stoul(value());
+        else if (arg == "--max")
+            args.scale.max = std::stof(value());
+        else if (arg == "--min")
+            args.scale.min = std::stof(value());
+        else if (arg == "-b" || arg == "--baud")
+            args.baud = std::stoul(value());
+        else if (arg == "-w" || arg == "--window")
+            args.window = std::stoul(value());
+        else if (arg == "--fps")
+            args.fps = std::max(1UL, std::stoul(value()));
+        else if (!arg.starts_with('-') && args.device == nullptr)
+            args.device = argv[i];
+        else
+            help(argv[0]);
+    }
+}
+
+// Receives, decodes and draws in one process. Frames arriving faster than the display rate only
+// replace the pending spectrum, the latency shown is from the read that delivered a spectrum to
+// the write that drew it.
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    auto link = mi::Link::open(args.device, args.baud, args.window);
+    if (!link.has_value())
+    {
+        std::cerr << "Failed to open " << args.device << ": " << link.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto decoder = std::make_unique<mi::SpectrumDecoder>();
+    auto loop = mi::EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> latest;
+    Clock::time_point arrived;
+    bool pending = false;
+    bool done = false;
+    std::size_t errors = 0;
+    std::size_t frames = 0;
+    std::size_t frames_per_second = 0;
+    Clock::time_point second_start = Clock::now();
+
+    auto on_spectrum = [&](std::span<const uint8_t> amplitudes)
+    {
+        latest.assign(amplitudes.begin(), amplitudes.end());
+        arrived = link.value()->last_read();
+        pending = true;
+        ++frames;
+    };
+    auto on_message = [&](tl::expected<mi::Message, mi::Error> message)
+    {
+        if (!message.has_value() || decoder->decode(message.value(), on_spectrum).has_value())
+            ++errors;
+    };
+
+    std::vector<float> heights;
+    std::string status;
+    // Kept from frame to frame, so a frame only writes the cells it changes
+    mi::Screen screen;
+    std::string out;
+    const mi::FdSink terminal{STDOUT_FILENO};
+    auto render = [&]()
+    {
+        const auto now = Clock::now();
+        if (now - second_start >= std::chrono::seconds{1})
+        {
+            frames_per_second = frames;
+            frames = 0;
+            second_start = now;
+        }
+
+        mi::scale(std::span<const uint8_t>{latest}, args.scale, heights);
+        const std::chrono::duration<double, std::milli> latency = Clock::now() - arrived;
+        status.clear();
+        fmt::format_to(std::back_inserter(status),
+                       "{} bands | {:.2f} ms latency | {} frames/s | {} errors | {} resyncs",
+                       latest.size(),
+                       latency.count(),
+                       frames_per_second,
+                       errors,
+                       link.value()->stats().resyncs);
+        screen.clear(args.scale.lines + 1, std::max(heights.size(), status.size()));
+        mi::render_bars(heights, args.scale.lines, screen);
+        screen.print(args.scale.lines, 0, status);
+        out.clear();
+        screen.flush(out);
+        terminal(std::span{reinterpret_cast<const uint8_t*>(out.data()), out.size()});
+        pending = false;
+    };
+
+    auto on_readable = [&](uint32_t)
+    {
+        if (!link.value()->read(on_message)) done = true;
+    };
+
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+    std::cout << "\x1b[?25l" << std::flush;
+
+    const auto interval = std::chrono::microseconds{1'000'000 / args.fps};
+    Clock::time_point next_render = Clock::now();
+    auto render_when_due = [&]()
+    {
+        if (!pending || Clock::now() < next_render) return;
+        render();
+        next_render = Clock::now() + interval;
+    };
+
+    if (auto error = loop->add(link.value()->fd(), EPOLLIN, on_readable))
+    {
+        // A file redirected to stdin can't be polled, but never blocks either
+        if (error.value() != std::errc::operation_not_permitted)
+        {
+            std::cerr << "Failed to watch the input: " << error.value().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        while (!stop_requested && link.value()->read(on_message))
+            render_when_due();
+        if (pending) render();
+    }
+    else
+    {
+        // Heartbeats keep the board streaming without micro_proj running alongside
+        auto heartbeat = mi::keep_alive(*loop, *link.value());
+        if (!heartbeat.has_value())
+        {
+            std::cerr << "Failed to start the heartbeat: " << heartbeat.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        while (!stop_requested && !done)
+        {
+            int timeout_ms = -1;
+            if (pending)
+            {
+                const auto until_render = next_render - Clock::now();
+                timeout_ms = std::max<int>(
+                    0, std::chrono::ceil<std::chrono::milliseconds>(until_render).count());
+            }
+            if (auto error = loop->run_once(timeout_ms))
+            {
+                std::cerr << "Event loop failed: " << error.value().message() << '\n';
+                break;
+            }
+            render_when_due();
+        }
+    }
+    std::cout << fmt::format("\x1b[{};1H\x1b[?25h", screen.rows() + 1) << std::flush;
+}
@@ -3,100 +3,248 @@
 
 #define MI_IMPLEMENT
 #include "include/message_definitions.hpp"
+#include "include/event_loop.hpp"
+#include "include/session.hpp"
+#include "include/spectrum_decoder.hpp"
+#include "include/spectrum_ring.hpp"
 #include "include/to_string.hpp"
-#include "sender.hpp"
-#include <fstream>
+#include <array>
+#include <cctype>
+#include <deque>
 #include <iostream>
-#include <syncstream>
-#include <thread>
+#include <string>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace mi;
 
-using SetFreqDataSender = Sender<255>;
-using HeartbeatSender = Sender<10>;
-
 void print_error(std::optional<Error> err);
-void broadcast_heartbeat(HeartbeatSender& comm);
-void setFreqData(SetFreqDataSender& comm);
 
-template<typename T> auto prompt(std::string_view prompt) -> T
+// Commands are typed a number at a time, as stdin delivers them, so the event loop never waits
+// for the user. Whatever the next command still lacks gets prompted for.
+struct Console
 {
-    std::osyncstream{std::cerr} << prompt;
-    T input;
-    std::cin >> input;
-    return input;
-}
+    // Splits what stdin delivered into words, a word cut off at the end waits for the rest
+    void feed(std::string_view input);
+    // Runs every complete command, returns false once asked to exit
+    auto execute(Session& session) -> bool;
+
+private:
+    struct Command
+    {
+        std::vector<const char*> prompts;
+        void (*run)(Session& session, const std::deque<std::string>& arguments);
+    };
+
+    static void set_freq_data(Session& session, const std::deque<std::string>& arguments);
+    static void set_stream_config(Session& session, const std::deque<std::string>& arguments);
+
+    const std::array<Command, 3> commands{{
+        {{"Enter min frequency: ", "Enter step frequency: "}, set_freq_data},
+        {{}, nullptr},
+        {{"Enter encoding (0 - plain, 1 - delta, 2 - packed, "
+          "3 - raw samples, 4 - delta coded raw samples): ",
+          "Enter keyframe interval: ",
+          "Enter bits per band (4 - 8): ",
+          "Enter spectra per batch: "},
+         set_stream_config},
+    }};
+    std::string partial;
+    std::deque<std::string> words;
+    std::size_t prompted = SIZE_MAX;
+};
 
-class Out
+// Usage: micro_proj [-b BAUD] [-w WINDOW] [--shm NAME] DEVICE
+// Talks to the board over a single session: heartbeats every second, commands from stdin, and
+// every spectrum the board sends published to the shared memory ring NAME, /mi_spectrum by
+// default, for `vis --shm NAME` to draw.
+int main(int argc, char** argv)
 {
-public:
-    void put(uint8_t value) { ss << value; }
+    uint32_t baud = 115200;
+    uint32_t window = 32;
+    const char* shm = "/mi_spectrum";
+    const char* device = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        if ((arg == "-b" || arg == "--baud") && i + 1 < argc)
+            baud = std::stoul(argv[++i]);
+        else if ((arg == "-w" || arg == "--window") && i + 1 < argc)
+            window = std::stoul(argv[++i]);
+        else if (arg == "--shm" && i + 1 < argc)
+            shm = argv[++i];
+        else
+            device = argv[i];
+    }
+    if (device == nullptr)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-b BAUD] [-w WINDOW] [--shm NAME] DEVICE\n";
+        return EXIT_FAILURE;
+    }
 
-    void flush()
+    auto loop = EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto ring = SpectrumRingWriter::create(shm);
+    if (!ring.has_value())
     {
-        std::osyncstream{std::cout} << ss.str() << std::flush;
-        ss.str("");
-        ss.clear();
+        std::cerr << "Failed to create " << shm << ": " << ring.error().message() << '\n';
+        return EXIT_FAILURE;
     }
+    auto decoder = std::make_unique<SpectrumDecoder>();
 
-private:
-    std::stringstream ss;
-};
+    std::unique_ptr<Session> session;
+    auto on_spectrum = [&](std::span<const uint8_t> amplitudes)
+    { print_error(ring->publish(session->last_read(), amplitudes)); };
+    auto on_message = [&](tl::expected<Message, Error> message)
+    {
+        if (!message.has_value())
+            print_error(message.error());
+        else
+            print_error(decoder->decode(message.value(), on_spectrum));
+    };
+    auto on_closed = [&]()
+    {
+        std::cerr << device << " closed\n";
+        loop->stop();
+    };
+    auto opened = Session::open(*loop, device, baud, window, on_message, on_closed);
+    if (!opened.has_value())
+    {
+        std::cerr << "Failed to open " << device << ": " << opened.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    session = std::move(opened.value());
 
-static Out heartbeat_out;
-static Out set_freq_out;
+    Console console;
+    std::array<char, 256> input;
+    auto on_input = [&](uint32_t)
+    {
+        const ssize_t len = read(STDIN_FILENO, input.data(), input.size());
+        if (len <= 0)
+        {
+            loop->stop();
+            return;
+        }
+        console.feed({input.data(), static_cast<std::size_t>(len)});
+        if (!console.execute(*session)) loop->stop();
+    };
+    if (auto error = loop->add(STDIN_FILENO, EPOLLIN, on_input))
+    {
+        std::cerr << "Failed to watch stdin: " << error.value().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    (void)console.execute(*session);
 
-int main()
+    if (auto error = loop->run())
+    {
+        std::cerr << "Event loop failed: " << error.value().message() << '\n';
+        return EXIT_FAILURE;
+    }
+}
+
+void Console::feed(std::string_view input)
 {
-    bool run = true;
-    HeartbeatSender heartbeat_comm{([](uint8_t byte) { heartbeat_out.put(byte); })};
-    SetFreqDataSender comm{([](uint8_t byte) { set_freq_out.put(byte); })};
-    const std::jthread heartbeat_thread{
-        [&heartbeat_comm, &run]()
+    for (char c : input)
+    {
+        if (!std::isspace(static_cast<unsigned char>(c)))
+        {
+            partial += c;
+            continue;
+        }
+        if (!partial.empty()) words.push_back(std::move(partial));
+        partial.clear();
+    }
+}
+
+auto Console::execute(Session& session) -> bool
+{
+    while (true)
+    {
+        if (words.empty())
+        {
+            if (prompted == 0) return true;
+            prompted = 0;
+            std::cerr << "Enter command\n"
+                         "Set freq data:\t0\n"
+                         "Exit:\t\t1\n"
+                         "Set stream config:\t2\n";
+            return true;
+        }
+
+        std::size_t index = commands.size();
+        try
         {
-            while (run)
+            index = std::stoul(words.front());
+        }
+        catch (const std::exception&)
+        {
+        }
+        if (index >= commands.size())
+        {
+            std::cerr << "Unknown command " << words.front() << '\n';
+            words.pop_front();
+            prompted = SIZE_MAX;
+            continue;
+        }
+        if (commands[index].run == nullptr) return false;
+
+        const Command& command = commands[index];
+        const std::size_t given = words.size() - 1;
+        if (given < command.prompts.size())
+        {
+            // Words already typed were prompted for, only the next one needs asking
+            if (prompted != given + 1)
             {
-                broadcast_heartbeat(heartbeat_comm);
-                std::this_thread::sleep_for(std::chrono::seconds{1});
+                prompted = given + 1;
+                std::cerr << command.prompts[given];
             }
-        }};
+            return true;
+        }
 
-    while (run)
-    {
-        switch (prompt<uint32_t>("Enter command\n"
-                                 "Set freq data:\t0\n"
-                                 "Exit:\t\t1\n"))
+        words.pop_front();
+        std::deque<std::string> arguments;
+        for (std::size_t i = 0; i < command.prompts.size(); ++i)
+        {
+            arguments.push_back(std::move(words.front()));
+            words.pop_front();
+        }
+        try
+        {
+            command.run(session, arguments);
+        }
+        catch (const std::exception&)
         {
-        case 0: setFreqData(comm); break;
-        case 1: run = false; break;
+            std::cerr << "Invalid arguments\n";
         }
+        prompted = SIZE_MAX;
     }
 }
 
-void broadcast_heartbeat(HeartbeatSender& comm)
+void Console::set_freq_data(Session& session, const std::deque<std::string>& arguments)
 {
-    static uint8_t next_seq = 0;
-    Heartbeat next_heartbeat{next_seq++};
-    std::optional<Error> const err = comm.send(next_heartbeat);
-    print_error(err);
-    heartbeat_out.flush();
+    SetFrequencyData data{static_cast<uint32_t>(std::stoul(arguments[0])),
+                          std::stof(arguments[1])};
+    print_error(session.send(data));
 }
 
-void setFreqData(SetFreqDataSender& comm)
+void Console::set_stream_config(Session& session, const std::deque<std::string>& arguments)
 {
-    auto min_freq = prompt<uint32_t>("Enter min frequency: ");
-    auto step_freq = prompt<float>("Enter step frequency: ");
-    SetFrequencyData data{min_freq, step_freq};
-    std::optional<Error> const err = comm.send(data);
-    print_error(err);
-    set_freq_out.flush();
+    StreamConfig config{static_cast<FrameEncoding>(std::stoul(arguments[0])),
+                        static_cast<uint8_t>(std::stoul(arguments[1])),
+                        static_cast<uint8_t>(std::stoul(arguments[2])),
+                        static_cast<uint8_t>(std::stoul(arguments[3]))};
+    print_error(session.send(config));
 }
 
 void print_error(std::optional<Error> err)
 {
     if (err && err.value() != Error::NO_ERROR)
     {
-        std::osyncstream{std::cerr} << "Encountered error: " << static_cast<unsigned>(err.value())
-                                    << '\n';
+        std::cerr << "Encountered error: " << static_cast<unsigned>(err.value()) << '\n';
     }
 }
@@ -0,0 +1,170 @@
+#define MI_IMPLEMENT
+#include "capture.hpp"
+#include "event_loop.hpp"
+#include "link.hpp"
+#include "session.hpp"
+#include "spectrum_decoder.hpp"
+
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+
+struct
+{
+    uint32_t baud = 115200;
+    uint32_t window = 32;
+    bool raw = false;
+    const char* file = nullptr;
+    const char* device = nullptr;
+} args;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void help(std::string_view program)
+{
+    std::cout << "Example Usage: " << program
+              << " [options] FILE [DEVICE]\n"
+                 "Captures the spectra from DEVICE, or from stdin without one, into FILE until\n"
+                 "the input ends or the recorder is interrupted.\n"
+                 "Options:\n"
+                 "  -b, --baud <baud>    Baud rate of the device\n"
+                 "  -w, --window <n>     Frames the board may send ahead of the recorder\n"
+                 "  --raw                Capture the bytes read off the link as well\n"
+                 "  --help               Display this message\n";
+    exit(EXIT_FAILURE);
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for " << arg << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+        if (arg == "-b" || arg == "--baud")
+            args.baud = std::stoul(value());
+        else if (arg == "-w" || arg == "--window")
+            args.window = std::stoul(value());
+        else if (arg == "--raw")
+            args.raw = true;
+        else if (!arg.starts_with('-') && args.file == nullptr)
+            args.file = argv[i];
+        else if (!arg.starts_with('-') && args.device == nullptr)
+            args.device = argv[i];
+        else
+            help(argv[0]);
+    }
+    if (args.file == nullptr) help(argv[0]);
+}
+
+// Writes every decoded spectrum, and with --raw every read, to a capture file for replay
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    auto link = mi::Link::open(args.device, args.baud, args.window);
+    if (!link.has_value())
+    {
+        std::cerr << "Failed to open " << (args.device != nullptr ? args.device : "stdin") << ": "
+                  << link.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto capture = mi::CaptureWriter::create(args.file);
+    if (!capture.has_value())
+    {
+        std::cerr << "Failed to create " << args.file << ": " << capture.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto decoder = std::make_unique<mi::SpectrumDecoder>();
+
+    std::optional<std::error_code> failure;
+    std::size_t spectra = 0;
+    std::size_t errors = 0;
+    auto on_spectrum = [&](std::span<const uint8_t> amplitudes)
+    {
+        if (!failure)
+        {
+            failure = capture->append(
+                mi::capture::Kind::SPECTRUM, link.value()->last_read(), amplitudes);
+        }
+        ++spectra;
+    };
+    auto on_message = [&](tl::expected<mi::Message, mi::Error> message)
+    {
+        if (!message.has_value() || decoder->decode(message.value(), on_spectrum).has_value())
+            ++errors;
+    };
+    // Returns false once there is nothing more to record
+    auto read = [&]() -> bool
+    {
+        const bool open = link.value()->read(on_message);
+        const auto bytes = link.value()->last_bytes();
+        if (args.raw && !failure && !bytes.empty())
+        {
+            failure = capture->append(
+                mi::capture::Kind::LINK_BYTES, link.value()->last_read(), bytes);
+        }
+        return open && !failure;
+    };
+
+    auto loop = mi::EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    bool done = false;
+    auto on_readable = [&](uint32_t)
+    {
+        if (!read()) done = true;
+    };
+
+    // The index is only written on a clean finish, so stop on a signal rather than die of it
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+    if (auto error = loop->add(link.value()->fd(), EPOLLIN, on_readable))
+    {
+        // A file redirected to stdin can't be polled, but never blocks either
+        if (error.value() != std::errc::operation_not_permitted)
+        {
+            std::cerr << "Failed to watch the input: " << error.value().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        while (!stop_requested && read())
+            ;
+    }
+    else
+    {
+        auto heartbeat = mi::keep_alive(*loop, *link.value());
+        if (!heartbeat.has_value())
+        {
+            std::cerr << "Failed to start the heartbeat: " << heartbeat.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        while (!stop_requested && !done)
+        {
+            if (auto error = loop->run_once(-1))
+            {
+                std::cerr << "Event loop failed: " << error.value().message() << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (!failure) failure = capture->finish();
+    if (failure)
+    {
+        std::cerr << "Failed to write " << args.file << ": " << failure->message() << '\n';
+        return EXIT_FAILURE;
+    }
+    std::cerr << "Captured " << spectra << " spectra, " << errors << " errors\n";
+}
@@ -1,39 +1,143 @@
 #define MI_IMPLEMENT
-#include "receiver.hpp"
+#include "event_loop.hpp"
+#include "link.hpp"
+#include "session.hpp"
+#include "spectrum_decoder.hpp"
+#include "spectrum_record.hpp"
+#include "spectrum_ring.hpp"
 
 #include <iostream>
-#include <ranges>
+#include <memory>
+#include <optional>
 #include <string>
+#include <sys/epoll.h>
+#include <vector>
 
 #define ERR(MESSAGE)                                                                               \
     {                                                                                              \
         std::cerr << MESSAGE;                                                                      \
-        continue;                                                                                  \
+        return;                                                                                    \
     }
 
-int main()
+// Usage: recv [-b BAUD] [-w WINDOW] [--binary | --shm NAME] [DEVICE]
+// Without a device the frames are read from stdin. With one, recv grants the board credits for
+// WINDOW frames (32 by default) and tops them up as it consumes frames, so the board never runs
+// ahead of the visualisation. Spectra are printed as lines of decimal amplitudes, or with
+// --binary as the records of spectrum_record.hpp, written once per read. With --shm they go to
+// the shared memory ring NAME instead, for any number of `vis --shm NAME` to draw.
+int main(int argc, char** argv)
 {
-    mi::Receiver<5000> receiver;
-    char c;
-    while (std::cin.get(c))
+    uint32_t baud = 115200;
+    uint32_t window = 32;
+    bool binary = false;
+    const char* shm = nullptr;
+    const char* device = nullptr;
+    for (int i = 1; i < argc; ++i)
     {
-        receiver.put(c);
-        if (!receiver.ready()) continue;
+        std::string_view arg{argv[i]};
+        if ((arg == "-b" || arg == "--baud") && i + 1 < argc)
+            baud = std::stoul(argv[++i]);
+        else if ((arg == "-w" || arg == "--window") && i + 1 < argc)
+            window = std::stoul(argv[++i]);
+        else if (arg == "--binary")
+            binary = true;
+        else if (arg == "--shm" && i + 1 < argc)
+            shm = argv[++i];
+        else
+            device = argv[i];
+    }
 
-        auto maybe_message = receiver.collect();
+    auto link = mi::Link::open(device, baud, window);
+    if (!link.has_value())
+    {
+        std::cerr << "Failed to open " << device << ": " << link.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto decoder = std::make_unique<mi::SpectrumDecoder>();
+    std::optional<mi::SpectrumRingWriter> ring;
+    if (shm != nullptr)
+    {
+        auto created = mi::SpectrumRingWriter::create(shm);
+        if (!created.has_value())
+        {
+            std::cerr << "Failed to create " << shm << ": " << created.error().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        ring.emplace(std::move(created.value()));
+    }
+
+    std::vector<uint8_t> records;
+    auto print = [&](std::span<const uint8_t> amplitudes)
+    {
+        if (ring.has_value())
+        {
+            if (auto error = ring->publish(link.value()->last_read(), amplitudes))
+                ERR("Failed to publish spectrum with error code: "
+                    << static_cast<uint32_t>(error.value()) << '\n');
+            return;
+        }
+        if (binary)
+        {
+            mi::append_record(records, link.value()->last_read(), amplitudes);
+            return;
+        }
+        for (auto amplitude : amplitudes)
+            std::cout << static_cast<uint32_t>(amplitude) << " ";
+        std::cerr << "Success" << '\n';
+        std::cout << std::endl;
+    };
+
+    auto on_message = [&](tl::expected<mi::Message, mi::Error> maybe_message)
+    {
         if (!maybe_message.has_value())
             ERR("Failed to collect message with error code: "
                 << static_cast<uint32_t>(maybe_message.error()) << '\n');
 
-        auto message = maybe_message.value();
-
-        if (message.index() != mi::FourierData::id) ERR("Wrong message type\n");
+        if (auto error = decoder->decode(maybe_message.value(), print))
+            ERR("Failed to decode message with error code: "
+                << static_cast<uint32_t>(error.value()) << '\n');
+    };
 
-        auto data = std::get<mi::FourierData>(message);
+    // Everything one read produced goes out in a single write
+    auto read = [&]() -> bool
+    {
+        const bool open = link.value()->read(on_message);
+        mi::FdSink{STDOUT_FILENO}(records);
+        records.clear();
+        return open;
+    };
 
-        for (auto amplitude : data.amplitudes)
-            std::cout << static_cast<uint32_t>(amplitude) << " ";
-        std::cerr << "Success" << '\n';
-        std::cout << std::endl;
+    auto loop = mi::EventLoop::create();
+    if (!loop.has_value())
+    {
+        std::cerr << "Failed to create the event loop: " << loop.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    auto on_readable = [&](uint32_t)
+    {
+        if (!read()) loop->stop();
+    };
+    if (auto error = loop->add(link.value()->fd(), EPOLLIN, on_readable))
+    {
+        // A file redirected to stdin can't be polled, but never blocks either
+        if (error.value() != std::errc::operation_not_permitted)
+        {
+            std::cerr << "Failed to watch the input: " << error.value().message() << '\n';
+            return EXIT_FAILURE;
+        }
+        while (read())
+            ;
+        return EXIT_SUCCESS;
+    }
+    auto heartbeat = mi::keep_alive(*loop, *link.value());
+    if (!heartbeat.has_value())
+    {
+        std::cerr << "Failed to start the heartbeat: " << heartbeat.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    if (auto error = loop->run())
+    {
+        std::cerr << "Event loop failed: " << error.value().message() << '\n';
+        return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,167 @@
+#define MI_IMPLEMENT
+#include "capture.hpp"
+#include "fd_sink.hpp"
+#include "receiver.hpp"
+#include "spectrum_decoder.hpp"
+#include "spectrum_record.hpp"
+
+#include <chrono>
+#include <fmt/format.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct
+{
+    double speed = 1;
+    bool raw = false;
+    bool decode = false;
+    double from = 0;
+    const char* file = nullptr;
+} args;
+
+void help(std::string_view program)
+{
+    std::cout << "Example Usage: " << program
+              << " [options] FILE | vis --binary\n"
+                 "Plays a capture of record back at the pace it was recorded. Spectra go to\n"
+                 "stdout as the records of recv --binary.\n"
+                 "Options:\n"
+                 "  --speed <factor>     Play back this many times faster\n"
+                 "  --max                Play back as fast as possible\n"
+                 "  --raw                Write the captured link bytes instead, for recv or live\n"
+                 "  --decode             Decode the captured link bytes in process and write\n"
+                 "                       nothing, to measure the host's throughput\n"
+                 "  --from <seconds>     Start this far into the capture\n"
+                 "  --help               Display this message\n";
+    exit(EXIT_FAILURE);
+}
+
+void parse_args(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        auto value = [&]() -> const char*
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for " << arg << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+        if (arg == "--speed")
+            args.speed = std::stod(value());
+        else if (arg == "--max")
+            args.speed = 0;
+        else if (arg == "--raw")
+            args.raw = true;
+        else if (arg == "--decode")
+            args.decode = true;
+        else if (arg == "--from")
+            args.from = std::stod(value());
+        else if (!arg.starts_with('-') && args.file == nullptr)
+            args.file = argv[i];
+        else
+            help(argv[0]);
+    }
+    if (args.file == nullptr || args.speed < 0) help(argv[0]);
+}
+
+// Replays one kind of entry of a capture. The time between entries is kept, divided by the
+// speed, so a capture replayed at 1x reproduces the original stream and at --max measures how
+// fast the host gets through it. A summary of the throughput goes to stderr.
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+
+    auto capture = mi::CaptureReader::open(args.file);
+    if (!capture.has_value())
+    {
+        std::cerr << "Failed to open " << args.file << ": " << capture.error().message() << '\n';
+        return EXIT_FAILURE;
+    }
+    const auto kind =
+        args.raw || args.decode ? mi::capture::Kind::LINK_BYTES : mi::capture::Kind::SPECTRUM;
+
+    std::size_t offset = capture->begin();
+    if (auto first = capture->next(offset))
+    {
+        const auto from = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>{args.from});
+        offset = capture->seek(first->timestamp + from);
+    }
+
+    auto receiver = std::make_unique<mi::Receiver<mi::max_encoded_size<mi::Message>>>();
+    auto decoder = std::make_unique<mi::SpectrumDecoder>();
+    std::size_t spectra = 0;
+    std::size_t errors = 0;
+    auto on_spectrum = [&spectra](std::span<const uint8_t>) { ++spectra; };
+    auto on_message = [&](tl::expected<mi::Message, mi::Error> message)
+    {
+        if (!message.has_value() || decoder->decode(message.value(), on_spectrum).has_value())
+            ++errors;
+    };
+
+    // Everything that is due goes out in one write, at --max that is up to a buffer full
+    constexpr std::size_t max_pending = 1 << 16;
+    std::vector<uint8_t> pending;
+    const mi::FdSink out{STDOUT_FILENO};
+    auto flush = [&]()
+    {
+        out(pending);
+        pending.clear();
+    };
+
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+    std::optional<Clock::time_point> captured_start;
+    const Clock::time_point start = Clock::now();
+    while (auto entry = capture->next(offset))
+    {
+        if (entry->kind != kind) continue;
+        if (!captured_start) captured_start = entry->timestamp;
+        if (args.speed > 0)
+        {
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(
+                                         (entry->timestamp - *captured_start) / args.speed);
+            if (due > Clock::now())
+            {
+                flush();
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        ++entries;
+        bytes += entry->payload.size();
+        if (args.decode)
+            receiver->put(entry->payload, on_message);
+        else if (args.raw)
+            pending.insert(pending.end(), entry->payload.begin(), entry->payload.end());
+        else
+            mi::append_record(pending, Clock::now(), entry->payload);
+        if (pending.size() >= max_pending) flush();
+    }
+    flush();
+
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cerr << fmt::format("Replayed {} entries, {} bytes in {:.3f} s: {:.2f} MB/s",
+                             entries,
+                             bytes,
+                             elapsed.count(),
+                             bytes / elapsed.count() / 1e6);
+    if (args.decode)
+    {
+        std::cerr << fmt::format(", {} spectra, {:.0f} spectra/s, {} errors",
+                                 spectra,
+                                 spectra / elapsed.count(),
+                                 errors);
+    }
+    std::cerr << '\n';
+}
@@ -1,19 +1,50 @@
 #define MI_IMPLEMENT
+#include "async_link.hpp"
+#include "bars.hpp"
+#include "batch.hpp"
+#include "bit_pack.hpp"
+#include "capture.hpp"
+#include "credits.hpp"
+#include "delta_codec.hpp"
+#include "event_loop.hpp"
 #include "fft.hpp"
+#include "mailbox.hpp"
 #include "main.hpp"
 #include "message_definitions.hpp"
+#include "raw_samples.hpp"
 #include "receiver.hpp"
+#include "screen.hpp"
 #include "sender.hpp"
+#include "serial_port.hpp"
+#include "session.hpp"
+#include "signal_source.hpp"
+#include "simulated_board.hpp"
+#include "spectrum_aligner.hpp"
+#include "spectrum_decoder.hpp"
+#include "spectrum_record.hpp"
+#include "spectrum_ring.hpp"
+#include "stft.hpp"
+#include "task.hpp"
+#include "timer.hpp"
 #include "to_string.hpp"
+#include "waterfall.hpp"
 
 #include "tl-expected.hpp"
 
+#include <cstdio>
+#include <fcntl.h>
 #include <fmt/format.h>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <list>
 #include <numeric>
 #include <ostream>
+#include <poll.h>
+#include <random>
 #include <string>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <thread>
 
 using namespace mi;
 
@@ -248,6 +279,18 @@ std::vector<MessageStaticTypingTest::ParamType> message_static_typing_test_cases
         message_t{FourierData::id, static_data_view({1, 2})},
         FourierData{static_span({uint8_t{1}, uint8_t{2}})},
     },
+    {
+        message_t{StreamConfig::id, static_data_view({1, 8, 6, 4})},
+        StreamConfig{FrameEncoding::DELTA, 8, 6, 4},
+    },
+    {
+        message_t{Heartbeat::id, static_data_view({1, 2})},
+        tl::unexpected{Error::INCORRECT_ALIGNMENT},
+    },
+    {
+        message_t{42, static_data_view({1})},
+        tl::unexpected{Error::UNKNOWN_MSG_ID},
+    },
 };
 
 INSTANTIATE_TEST_SUITE_P(,
@@ -268,6 +311,88 @@ TEST(ReceiverTest, ShouldReceive)
     EXPECT_EQ(std::get<Heartbeat::id>(collected.value()), Heartbeat{0});
 }
 
+TEST(ReceiverTest, ShouldReceiveAllFramesInSpan)
+{
+    static std::vector<uint8_t> stream{0x01, 0x02};
+    Sender<10> sender{([](std::span<const uint8_t> bytes)
+                       { stream.insert(stream.end(), bytes.begin(), bytes.end()); })};
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        Heartbeat heartbeat{i};
+        ASSERT_FALSE(sender.send(heartbeat).has_value());
+        stream.push_back(0x03);
+    }
+
+    Receiver<20> receiver;
+    std::vector<Heartbeat> received;
+    auto on_message = [&received](tl::expected<Message, Error> collected)
+    {
+        ASSERT_TRUE(collected.has_value()) << static_cast<uint32_t>(collected.error());
+        received.push_back(std::get<Heartbeat>(collected.value()));
+    };
+
+    const auto split = stream.size() - 3;
+    std::span<const uint8_t> bytes{stream};
+    EXPECT_EQ(receiver.put(bytes.first(split), on_message), 2);
+    EXPECT_EQ(receiver.put(bytes.subspan(split), on_message), 1);
+    ASSERT_EQ(received.size(), 3);
+    for (uint8_t i = 0; i < received.size(); ++i)
+    {
+        EXPECT_EQ(received[i], Heartbeat{i});
+    }
+}
+
+TEST(ReceiverTest, ShouldResynchronize)
+{
+    static std::vector<uint8_t> stream;
+    Sender<10> sender{([](std::span<const uint8_t> bytes)
+                       { stream.insert(stream.end(), bytes.begin(), bytes.end()); })};
+    Heartbeat heartbeat{7};
+    ASSERT_FALSE(sender.send(heartbeat).has_value());
+    const std::vector<uint8_t> frame = stream;
+
+    // Truncated frame interrupted by a fresh STX
+    stream.assign(frame.begin(), frame.begin() + 3);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    // Frame too long for the receiver's buffer
+    stream.push_back(magic::stx);
+    stream.insert(stream.end(), 30, 0x42);
+    stream.push_back(magic::etx);
+    // Frame with a corrupted payload
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    stream[stream.size() - frame.size() + 3] ^= 0x01;
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    for (bool bulk : {false, true})
+    {
+        Receiver<20> receiver;
+        std::vector<tl::expected<Message, Error>> collected;
+        auto on_message = [&collected](tl::expected<Message, Error> message)
+        { collected.push_back(message); };
+        if (bulk)
+        {
+            receiver.put(std::span<const uint8_t>{stream}, on_message);
+        }
+        else
+        {
+            for (auto c : stream)
+            {
+                receiver.put(c);
+                if (receiver.ready()) on_message(receiver.collect());
+            }
+        }
+
+        ASSERT_EQ(collected.size(), 3);
+        EXPECT_EQ(collected[0], Message{heartbeat});
+        EXPECT_EQ(collected[1], tl::unexpected{Error::INVALID_CRC});
+        EXPECT_EQ(collected[2], Message{heartbeat});
+        EXPECT_EQ(receiver.stats().resyncs, 1);
+        EXPECT_EQ(receiver.stats().overflows, 1);
+        EXPECT_EQ(receiver.stats().crc_failures, 1);
+        EXPECT_EQ(receiver.stats().discarded_bytes, 3 + 32);
+    }
+}
+
 class SenderTest : public testing::TestWithParam<Message>
 {
 protected:
@@ -278,7 +403,8 @@ protected:
 TEST_P(SenderTest, ShouldSend)
 {
     Message msg = GetParam();
-    Sender<100> sender{([](uint8_t byte) { out.push_back(byte); })};
+    Sender<100> sender{([](std::span<const uint8_t> bytes)
+                        { out.insert(out.end(), bytes.begin(), bytes.end()); })};
     Receiver<100> receiver;
     std::optional<Error> error = std::visit([&sender](auto m) { return sender.send(m); }, msg);
     EXPECT_FALSE(error.has_value()) << static_cast<uint32_t>(error.value());
@@ -296,6 +422,1173 @@ std::vector<Message> sender_test_cases{
     Heartbeat{0},
     SetFrequencyData{1, 0.5F},
     FourierData{static_span({uint8_t{1}, uint8_t{2}})},
+    StreamConfig{FrameEncoding::PACKED, 16, 5, 4},
+    FourierBatch{static_span({2, 2, 0, 1, 2, 3, 4})},
+    RawSamples{static_span({uint8_t{3}, RawSamples::packed_coding, uint8_t{2}, uint8_t{0},
+                            uint8_t{0x01}, uint8_t{0xF8}, uint8_t{0xFF}})},
+    FourierDelta{static_span({uint8_t{7}, uint8_t{0}, uint8_t{1}, uint8_t{0}, uint8_t{0x12}})},
+};
+
+INSTANTIATE_TEST_SUITE_P(, SenderTest, testing::ValuesIn(sender_test_cases));
+
+TEST(SenderSinkTest, ShouldHandMessageToSinkInOneChunk)
+{
+    struct CountingSink
+    {
+        void operator()(std::span<const uint8_t> bytes)
+        {
+            ++calls;
+            received.insert(received.end(), bytes.begin(), bytes.end());
+        }
+        std::size_t calls = 0;
+        std::vector<uint8_t> received;
+    } sink;
+
+    Sender<100, CountingSink&> sender{sink};
+    std::array<uint8_t, 4> amplitudes{magic::stx, magic::etx, magic::encoder, 1};
+    FourierData data{amplitudes};
+    ASSERT_FALSE(sender.send(data).has_value());
+    EXPECT_EQ(sink.calls, 1);
+    EXPECT_EQ(sink.received.front(), magic::stx);
+    EXPECT_EQ(sink.received.back(), magic::etx);
+}
+
+TEST(SenderSinkTest, ShouldStreamMessagesLargerThanChunk)
+{
+    struct ChunkSink
+    {
+        void operator()(std::span<const uint8_t> bytes)
+        {
+            largest = std::max(largest, bytes.size());
+            received.insert(received.end(), bytes.begin(), bytes.end());
+        }
+        std::size_t largest = 0;
+        std::vector<uint8_t> received;
+    } sink;
+
+    Sender<5, ChunkSink&> sender{sink};
+    std::vector<uint8_t> amplitudes(300);
+    std::mt19937 rng{7};
+    std::ranges::generate(amplitudes, [&rng]() { return rng() % 8 + magic::encoder - 4; });
+    FourierData data{amplitudes};
+    ASSERT_FALSE(sender.send(data).has_value());
+    EXPECT_LE(sink.largest, 5);
+
+    Receiver<1000> receiver;
+    std::size_t frames = receiver.put(std::span<const uint8_t>{sink.received},
+                                      [&data](tl::expected<Message, Error> collected)
+                                      {
+                                          ASSERT_TRUE(collected.has_value());
+                                          EXPECT_EQ(collected.value(), Message{data});
+                                      });
+    EXPECT_EQ(frames, 1);
+}
+
+TEST(CreditWindowTest, ShouldRefillHalfAWindowAtATime)
+{
+    CreditWindow credits{8};
+    EXPECT_EQ(credits.start(), StartStreamingData{8});
+    EXPECT_FALSE(credits.consume(3).has_value());
+    EXPECT_EQ(credits.consume(), StartStreamingData{4});
+    EXPECT_EQ(credits.consume(6), StartStreamingData{6});
+    EXPECT_FALSE(credits.consume(0).has_value());
+    EXPECT_EQ(CreditWindow{0}.start(), StartStreamingData{1});
+}
+
+static_assert(max_encoded_size<Heartbeat> == 2 * (1 + 2 + 1 + 2 + 1) - 2);
+static_assert(max_serialized_size<Heartbeat, SetFrequencyData> == 1 + 2 + 8 + 2 + 1);
+static_assert(max_encoded_size<Message> == max_encoded_size<FourierBatch>);
+
+TEST(MessageSizeTest, ShouldBoundWorstCaseEncoding)
+{
+    struct Sink
+    {
+        void operator()(std::span<const uint8_t> bytes)
+        {
+            received.insert(received.end(), bytes.begin(), bytes.end());
+        }
+        std::vector<uint8_t> received;
+    } sink;
+
+    // Nothing but bytes that need escaping
+    std::vector<uint8_t> amplitudes(limits::max_bands, magic::stx);
+    FourierData data{amplitudes};
+    Sender<64, Sink&> sender{sink};
+    ASSERT_FALSE(sender.send(data).has_value());
+    EXPECT_LE(sink.received.size(), max_encoded_size<FourierData>);
+
+    Receiver<max_encoded_size<FourierData>> receiver;
+    EXPECT_EQ(receiver.put(std::span<const uint8_t>{sink.received},
+                           [&data](tl::expected<Message, Error> collected)
+                           {
+                               ASSERT_TRUE(collected.has_value());
+                               EXPECT_EQ(collected.value(), Message{data});
+                           }),
+              1);
+    EXPECT_EQ(receiver.stats().overflows, 0);
+}
+
+TEST(DeltaCodecTest, ShouldRoundTrip)
+{
+    DeltaEncoder<64> encoder{8};
+    DeltaDecoder<64> decoder;
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> step{-3, 3};
+    std::array<uint8_t, 64> amplitudes{};
+    std::iota(amplitudes.begin(), amplitudes.end(), 100);
+    std::size_t keyframes = 0;
+    std::size_t sent = 0;
+
+    for (std::size_t frame = 0; frame < 100; ++frame)
+    {
+        for (std::size_t i = 0; i < amplitudes.size(); ++i)
+        {
+            if (i % 4 == 0) amplitudes[i] += step(rng);
+        }
+        amplitudes[frame % amplitudes.size()] ^= 0x80; // Jump that needs an escape
+
+        auto encoded = encoder.encode(amplitudes);
+        ASSERT_TRUE(encoded.has_value()) << static_cast<uint32_t>(encoded.error());
+        EXPECT_EQ(encoded->seq(), static_cast<uint8_t>(frame));
+        keyframes += encoded->keyframe();
+        sent += encoded->frame.size();
+
+        auto decoded = decoder.decode(encoded.value());
+        ASSERT_TRUE(decoded.has_value()) << static_cast<uint32_t>(decoded.error());
+        ASSERT_ITERABLE_EQ(amplitudes, decoded.value());
+    }
+    EXPECT_EQ(keyframes, 100 / 8 + 1);
+    EXPECT_LT(sent * 2, 100 * (FourierDelta::header_size + amplitudes.size()));
+}
+
+TEST(DeltaCodecTest, ShouldRecoverOnKeyframe)
+{
+    DeltaEncoder<16> encoder{4};
+    DeltaDecoder<16> decoder;
+    std::array<uint8_t, 16> amplitudes{};
+
+    for (uint8_t frame = 0; frame < 12; ++frame)
+    {
+        amplitudes.fill(frame);
+        auto encoded = encoder.encode(amplitudes);
+        ASSERT_TRUE(encoded.has_value());
+        if (frame == 5) continue; // Lost on the link
+
+        auto decoded = decoder.decode(encoded.value());
+        if (frame == 6 || frame == 7)
+        {
+            EXPECT_EQ(decoded, tl::unexpected{Error::MISSING_KEYFRAME});
+            continue;
+        }
+        ASSERT_TRUE(decoded.has_value()) << static_cast<uint32_t>(decoded.error());
+        ASSERT_ITERABLE_EQ(amplitudes, decoded.value());
+    }
+}
+
+struct BitPackTest : testing::TestWithParam<uint8_t>
+{
+};
+
+TEST_P(BitPackTest, ShouldRoundTrip)
+{
+    const uint8_t bits = GetParam();
+    BitPacker<64> packer;
+    BitUnpacker<64> unpacker;
+    std::mt19937 rng{bits};
+    std::uniform_int_distribution<int> amplitude{0, UINT8_MAX};
+
+    for (std::size_t bands = 0; bands <= 64; ++bands)
+    {
+        std::vector<uint8_t> amplitudes(bands);
+        std::ranges::generate(amplitudes, [&] { return amplitude(rng); });
+        if (bands > 0) amplitudes[0] = UINT8_MAX;
+
+        auto packed = packer.pack(amplitudes, bits);
+        ASSERT_TRUE(packed.has_value()) << static_cast<uint32_t>(packed.error());
+        EXPECT_EQ(packed->packed().size(), (bands * bits + 7) / 8);
+
+        auto serialized = packed->serialize();
+        auto deserialized = serialized.deserialize_into<PackedFourierData>();
+        ASSERT_TRUE(deserialized.has_value()) << static_cast<uint32_t>(deserialized.error());
+
+        auto unpacked = unpacker.unpack(deserialized.value());
+        ASSERT_TRUE(unpacked.has_value()) << static_cast<uint32_t>(unpacked.error());
+        ASSERT_EQ(unpacked->size(), bands);
+        for (std::size_t i = 0; i < bands; ++i)
+        {
+            const uint8_t kept = amplitudes[i] >> (8 - bits);
+            EXPECT_EQ((*unpacked)[i] >> (8 - bits), kept) << "Difference at index: " << i;
+        }
+        if (bands > 0)
+        {
+            EXPECT_EQ(unpacked->front(), UINT8_MAX);
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(, BitPackTest, testing::Values(4, 5, 6, 7, 8));
+
+TEST(BitPackerTest, ShouldRejectUnsupportedWidth)
+{
+    BitPacker<8> packer;
+    std::array<uint8_t, 8> amplitudes{};
+    EXPECT_EQ(packer.pack(amplitudes, 3), tl::unexpected{Error::INCORRECT_ALIGNMENT});
+}
+
+struct SampleCodecTest : testing::TestWithParam<bool>
+{
 };
 
-INSTANTIATE_TEST_SUITE_P(, SenderTest, testing::ValuesIn(sender_test_cases));
\ No newline at end of file
+TEST_P(SampleCodecTest, ShouldRoundTrip)
+{
+    const bool delta = GetParam();
+    SampleEncoder<64> encoder;
+    SampleDecoder<64> decoder;
+    std::mt19937 rng{3};
+    std::uniform_int_distribution<int> noise{-20, 20};
+
+    for (std::size_t count = 0; count <= 64; ++count)
+    {
+        // A slow ramp with noise, plus a few jumps only an escape can code
+        std::vector<uint16_t> samples(count);
+        for (std::size_t i = 0; i < count; ++i)
+            samples[i] = (i % 16 == 15 ? 4000 : 2048 + 8 * i + noise(rng)) & raw::sample_mask;
+
+        auto encoded = encoder.encode(samples, delta);
+        ASSERT_TRUE(encoded.has_value()) << static_cast<uint32_t>(encoded.error());
+        EXPECT_EQ(encoded->seq(), static_cast<uint8_t>(count));
+        EXPECT_LE(encoded->coded().size(), raw::packed_size(count));
+        if (!delta)
+        {
+            EXPECT_EQ(encoded->coding(), RawSamples::packed_coding);
+        }
+        if (delta && count > 8)
+        {
+            EXPECT_EQ(encoded->coding(), RawSamples::delta_coding);
+        }
+
+        auto serialized = encoded->serialize();
+        auto deserialized = serialized.deserialize_into<RawSamples>();
+        ASSERT_TRUE(deserialized.has_value()) << static_cast<uint32_t>(deserialized.error());
+
+        auto decoded = decoder.decode(deserialized.value());
+        ASSERT_TRUE(decoded.has_value()) << static_cast<uint32_t>(decoded.error());
+        ASSERT_ITERABLE_EQ(samples, decoded.value());
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(, SampleCodecTest, testing::Bool());
+
+TEST(StftTest, ShouldFindTone)
+{
+    constexpr std::size_t window = 256;
+    constexpr std::size_t bin = 20;
+    Stft<window> stft{window / 2};
+    std::vector<uint16_t> samples(window * 2);
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        const float phase = 2 * std::numbers::pi_v<float> * bin * i / window;
+        samples[i] = static_cast<uint16_t>(2048 + 1000 * std::sin(phase));
+    }
+
+    std::vector<std::vector<uint8_t>> spectra;
+    stft.push(samples, [&spectra](std::span<const uint8_t> bands)
+              { spectra.emplace_back(bands.begin(), bands.end()); });
+    ASSERT_EQ(spectra.size(), 3);
+    for (const auto& bands : spectra)
+    {
+        ASSERT_EQ(bands.size(), window / 2);
+        EXPECT_EQ(std::ranges::max_element(bands) - bands.begin(), bin);
+    }
+
+    stft.reset();
+    spectra.clear();
+    stft.push(std::span{samples}.first(window - 1), [&spectra](std::span<const uint8_t> bands)
+              { spectra.emplace_back(bands.begin(), bands.end()); });
+    EXPECT_TRUE(spectra.empty());
+}
+
+TEST(BatchBuilderTest, ShouldBatchSpectra)
+{
+    BatchBuilder<10> builder{3};
+    std::array<uint8_t, 3> first{1, 2, 3};
+    std::array<uint8_t, 3> second{4, 5, 6};
+    std::array<uint8_t, 3> third{7, 8, 9};
+    std::array<uint8_t, 3> fourth{10, 11, 12};
+
+    EXPECT_FALSE(builder.push(first).has_value());
+    EXPECT_FALSE(builder.push(second).has_value());
+    auto batch = builder.push(third);
+    ASSERT_TRUE(batch.has_value());
+
+    auto serialized = batch->serialize();
+    auto deserialized = serialized.deserialize_into<FourierBatch>();
+    ASSERT_TRUE(deserialized.has_value()) << static_cast<uint32_t>(deserialized.error());
+    EXPECT_EQ(deserialized->count(), 3);
+    EXPECT_EQ(deserialized->bands(), 3);
+    std::vector<std::span<uint8_t>> spectra;
+    std::ranges::copy(deserialized->spectra(), std::back_inserter(spectra));
+    ASSERT_EQ(spectra.size(), 3);
+    ASSERT_ITERABLE_EQ(spectra[0], first);
+    ASSERT_ITERABLE_EQ(spectra[1], second);
+    ASSERT_ITERABLE_EQ(spectra[2], third);
+    EXPECT_EQ(spectra[0].data(), serialized.data() + FourierBatch::header_size);
+
+    // Only three spectra of three bands fit the capacity, the batch closes early
+    builder.batch_size = 5;
+    EXPECT_FALSE(builder.push(first).has_value());
+    EXPECT_FALSE(builder.push(second).has_value());
+    auto early = builder.push(fourth);
+    ASSERT_TRUE(early.has_value());
+    EXPECT_EQ(early->count(), 3);
+    ASSERT_ITERABLE_EQ(early->spectrum(2), fourth);
+}
+
+TEST(SerialPortTest, ShouldExchangeRawBytes)
+{
+    const int controller = posix_openpt(O_RDWR | O_NOCTTY);
+    ASSERT_GE(controller, 0);
+    ASSERT_EQ(grantpt(controller), 0);
+    ASSERT_EQ(unlockpt(controller), 0);
+
+    auto port = SerialPort::open(ptsname(controller), 2'000'000);
+    ASSERT_TRUE(port.has_value()) << port.error().message();
+    termios2 tty{};
+    ASSERT_EQ(ioctl(port->fd(), TCGETS2, &tty), 0);
+    EXPECT_EQ(tty.c_ospeed, 2'000'000);
+    EXPECT_EQ(tty.c_ispeed, 2'000'000);
+
+    // Raw mode, CR, ^C and ^D all come through untouched
+    std::array<uint8_t, 4> sent{'\r', 0x03, 0x04, magic::stx};
+    ASSERT_EQ(write(controller, sent.data(), sent.size()), sent.size());
+    std::array<uint8_t, 16> received{};
+    std::size_t size = 0;
+    for (int attempt = 0; attempt < 100 && size < sent.size(); ++attempt)
+    {
+        pollfd readable{.fd = port->fd(), .events = POLLIN, .revents = 0};
+        poll(&readable, 1, 10);
+        auto len = port->read(std::span{received}.subspan(size));
+        ASSERT_TRUE(len.has_value()) << len.error().message();
+        size += len.value();
+    }
+    ASSERT_ITERABLE_EQ(sent, std::span{received}.first(size));
+    EXPECT_EQ(port->read(received), 0);
+
+    auto written = port->write(sent);
+    ASSERT_TRUE(written.has_value());
+    EXPECT_EQ(written.value(), sent.size());
+    close(controller);
+}
+
+TEST(EventLoopTest, ShouldDispatchReadyDescriptors)
+{
+    auto loop = EventLoop::create();
+    ASSERT_TRUE(loop.has_value()) << loop.error().message();
+    std::array<int, 2> pipe_ends{};
+    ASSERT_EQ(pipe(pipe_ends.data()), 0);
+    const auto [read_end, write_end] = pipe_ends;
+
+    std::vector<uint8_t> received;
+    auto on_readable = [&](uint32_t events)
+    {
+        EXPECT_TRUE(events & (EPOLLIN | EPOLLHUP));
+        std::array<uint8_t, 16> buffer{};
+        const ssize_t len = read(read_end, buffer.data(), buffer.size());
+        if (len <= 0)
+        {
+            loop->remove(read_end);
+            return;
+        }
+        received.insert(received.end(), buffer.begin(), buffer.begin() + len);
+    };
+    ASSERT_FALSE(loop->add(read_end, EPOLLIN, on_readable).has_value());
+
+    EXPECT_FALSE(loop->run_once(0).has_value());
+    EXPECT_TRUE(received.empty());
+
+    std::array<uint8_t, 3> sent{1, 2, 3};
+    ASSERT_EQ(write(write_end, sent.data(), sent.size()), sent.size());
+    close(write_end);
+    // Runs until the callback removes the pipe on end of file
+    EXPECT_FALSE(loop->run().has_value());
+    ASSERT_ITERABLE_EQ(sent, received);
+    close(read_end);
+}
+
+TEST(EventLoopTest, ShouldRetireCallbacksAcrossAMove)
+{
+    auto loop = EventLoop::create();
+    ASSERT_TRUE(loop.has_value()) << loop.error().message();
+    std::array<int, 2> pipe_ends{};
+    ASSERT_EQ(pipe(pipe_ends.data()), 0);
+
+    // The callback's state lives as long as the callback does
+    auto state = std::make_shared<int>(0);
+    ASSERT_FALSE(loop->add(pipe_ends[0], EPOLLIN, [state](uint32_t) {}).has_value());
+    loop->remove(pipe_ends[0]);
+    EXPECT_EQ(state.use_count(), 2);
+
+    // The loop it moved to finishes the round and lets go of the callback
+    EventLoop moved{std::move(loop.value())};
+    EXPECT_FALSE(moved.run_once(0).has_value());
+    EXPECT_EQ(state.use_count(), 1);
+    close(pipe_ends[0]);
+    close(pipe_ends[1]);
+}
+
+TEST(SpectrumRecordTest, ShouldReassembleSplitRecords)
+{
+    using namespace std::chrono_literals;
+    const std::chrono::steady_clock::time_point first{5ms};
+    const std::chrono::steady_clock::time_point second{7ms};
+    std::array<uint8_t, 3> low{1, 2, 3};
+    std::array<uint8_t, 2> high{250, 251};
+    std::vector<uint8_t> stream;
+    append_record(stream, first, low);
+    append_record(stream, second, high);
+    ASSERT_EQ(stream.size(), 2 * sizeof(SpectrumRecord) + low.size() + high.size());
+
+    for (std::size_t split = 0; split <= stream.size(); ++split)
+    {
+        SpectrumRecordReader reader;
+        std::vector<std::pair<std::chrono::steady_clock::time_point, std::vector<uint8_t>>> records;
+        auto on_record = [&records](auto timestamp, std::span<const uint8_t> amplitudes)
+        {
+            records.emplace_back(timestamp,
+                                 std::vector<uint8_t>{amplitudes.begin(), amplitudes.end()});
+        };
+        reader.put(std::span{stream}.first(split), on_record);
+        reader.put(std::span{stream}.subspan(split), on_record);
+
+        ASSERT_EQ(records.size(), 2) << "Split at: " << split;
+        EXPECT_EQ(records[0].first, first);
+        ASSERT_ITERABLE_EQ(records[0].second, low);
+        EXPECT_EQ(records[1].first, second);
+        ASSERT_ITERABLE_EQ(records[1].second, high);
+    }
+}
+
+TEST(SpectrumRingTest, ShouldHandOutOnlyTheNewestSpectrum)
+{
+    using namespace std::chrono_literals;
+    auto writer = SpectrumRingWriter::create(nullptr, 4);
+    ASSERT_TRUE(writer.has_value()) << writer.error().message();
+    auto reader = SpectrumRingReader::attach(writer->fd());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+
+    std::vector<uint8_t> received;
+    std::chrono::steady_clock::time_point received_at;
+    auto on_spectrum = [&](auto read_at, std::span<const uint8_t> amplitudes)
+    {
+        received.assign(amplitudes.begin(), amplitudes.end());
+        received_at = read_at;
+    };
+    EXPECT_FALSE(reader->latest(on_spectrum));
+
+    // More spectra than slots, the reader must still land on the last one
+    for (uint8_t i = 1; i <= 6; ++i)
+    {
+        std::vector<uint8_t> amplitudes(i, i);
+        ASSERT_FALSE(writer->publish(std::chrono::steady_clock::time_point{i * 1ms}, amplitudes));
+    }
+    ASSERT_TRUE(reader->latest(on_spectrum));
+    const std::vector<uint8_t> newest(6, 6);
+    ASSERT_ITERABLE_EQ(received, newest);
+    EXPECT_EQ(received_at, std::chrono::steady_clock::time_point{6ms});
+    EXPECT_EQ(reader->skipped(), 5);
+    EXPECT_FALSE(reader->latest(on_spectrum));
+
+    std::array<uint8_t, ring::default_max_bands + 1> too_many{};
+    EXPECT_EQ(writer->publish({}, too_many), Error::OUT_OF_MEMORY);
+}
+
+TEST(SpectrumRingTest, ShouldCarryTheSpectraOfRawSamples)
+{
+    auto writer = SpectrumRingWriter::create(nullptr, 2);
+    ASSERT_TRUE(writer.has_value()) << writer.error().message();
+    auto reader = SpectrumRingReader::attach(writer->fd());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+
+    // Enough blocks of a tone for the host side transform to fill its first window
+    SignalSource source{10'000.F};
+    source.tones.push_back({.frequency = 1250.F}); // Bin 512 of the 4096 point transform
+    SampleEncoder<limits::max_samples> encoder;
+    SpectrumDecoder decoder;
+    std::array<uint16_t, limits::max_samples> block;
+    std::size_t spectra = 0;
+    auto on_spectrum = [&](std::span<const uint8_t> amplitudes)
+    {
+        EXPECT_FALSE(writer->publish({}, amplitudes).has_value());
+        ++spectra;
+    };
+    for (std::size_t i = 0; i < SpectrumDecoder::stft_size / block.size(); ++i)
+    {
+        source.fill(block);
+        auto encoded = encoder.encode(block, false);
+        ASSERT_TRUE(encoded.has_value()) << static_cast<uint32_t>(encoded.error());
+        ASSERT_FALSE(decoder.decode(Message{encoded.value()}, on_spectrum).has_value());
+    }
+    ASSERT_EQ(spectra, 1);
+
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(reader->latest([&received](auto, std::span<const uint8_t> amplitudes)
+                               { received.assign(amplitudes.begin(), amplitudes.end()); }));
+    ASSERT_EQ(received.size(), SpectrumDecoder::stft_size / 2);
+    EXPECT_EQ(std::ranges::max_element(received) - received.begin(), 512);
+}
+
+TEST(SpectrumRingTest, ShouldTakeTheSlotWidthTheWriterPicks)
+{
+    constexpr uint32_t max_bands = 3 * ring::default_max_bands + 1;
+    auto writer = SpectrumRingWriter::create(nullptr, 2, max_bands);
+    ASSERT_TRUE(writer.has_value()) << writer.error().message();
+    auto reader = SpectrumRingReader::attach(writer->fd());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+
+    std::vector<uint8_t> widest(max_bands);
+    std::iota(widest.begin(), widest.end(), uint8_t{0});
+    for (int i = 0; i < 3; ++i)
+        ASSERT_FALSE(writer->publish({}, widest).has_value());
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(reader->latest([&received](auto, std::span<const uint8_t> amplitudes)
+                               { received.assign(amplitudes.begin(), amplitudes.end()); }));
+    ASSERT_ITERABLE_EQ(received, widest);
+
+    widest.push_back(0);
+    EXPECT_EQ(writer->publish({}, widest), Error::OUT_OF_MEMORY);
+}
+
+TEST(SpectrumRingTest, ShouldNeverHandOutATornSpectrum)
+{
+    auto writer = SpectrumRingWriter::create(nullptr, 2);
+    ASSERT_TRUE(writer.has_value()) << writer.error().message();
+    auto reader = SpectrumRingReader::attach(writer->fd());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+
+    constexpr int spectra = 100000;
+    std::atomic<bool> done = false;
+    auto produce = [&]()
+    {
+        std::array<uint8_t, limits::max_bands> amplitudes;
+        for (int i = 0; i < spectra; ++i)
+        {
+            amplitudes.fill(static_cast<uint8_t>(i));
+            (void)writer->publish({}, amplitudes);
+        }
+        done = true;
+    };
+    std::thread producer{produce};
+
+    std::size_t torn = 0;
+    auto on_spectrum = [&torn](auto, std::span<const uint8_t> amplitudes)
+    {
+        if (std::ranges::count(amplitudes, amplitudes.front()) != std::ssize(amplitudes)) ++torn;
+    };
+    while (!done)
+        reader->latest(on_spectrum);
+    producer.join();
+    EXPECT_EQ(torn, 0);
+}
+
+TEST(SpectrumRingTest, ShouldRejectMemoryThatIsNoRing)
+{
+    const int fd = memfd_create("not_a_ring", MFD_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, ring::mapping_size(2, ring::default_max_bands)), 0);
+    auto reader = SpectrumRingReader::attach(fd);
+    close(fd);
+    ASSERT_FALSE(reader.has_value());
+    EXPECT_EQ(reader.error(), std::errc::wrong_protocol_type);
+}
+
+TEST(SpectrumAlignerTest, ShouldCombineTheNewestSpectrumOfEverySource)
+{
+    using namespace std::chrono_literals;
+    using time_point = SpectrumAligner::Clock::time_point;
+    SpectrumAligner aligner{3, std::chrono::seconds{1}};
+    std::vector<std::pair<time_point, std::vector<uint8_t>>> combined;
+    auto on_combined = [&combined](time_point read_at, std::span<const uint8_t> amplitudes)
+    { combined.emplace_back(read_at, std::vector<uint8_t>{amplitudes.begin(), amplitudes.end()}); };
+    auto put = [&](std::size_t source, time_point read_at, std::vector<uint8_t> amplitudes)
+    { aligner.put(source, read_at, amplitudes, on_combined); };
+
+    // The first source runs ahead, only its newest spectrum makes it into the combination
+    put(0, time_point{1ms}, {1, 1});
+    put(0, time_point{2ms}, {2, 2});
+    put(2, time_point{3ms}, {3});
+    EXPECT_TRUE(combined.empty());
+    put(1, time_point{4ms}, {4, 4, 4});
+    ASSERT_EQ(combined.size(), 1);
+    EXPECT_EQ(combined[0].first, time_point{4ms});
+    const std::vector<uint8_t> first{2, 2, 4, 4, 4, 3};
+    ASSERT_ITERABLE_EQ(combined[0].second, first);
+    EXPECT_EQ(aligner.superseded(), 1);
+
+    // A closed source stops holding the others up
+    put(0, time_point{5ms}, {5, 5});
+    aligner.close(1);
+    put(2, time_point{6ms}, {6});
+    ASSERT_EQ(combined.size(), 2);
+    EXPECT_EQ(combined[1].first, time_point{6ms});
+    const std::vector<uint8_t> second{5, 5, 6};
+    ASSERT_ITERABLE_EQ(combined[1].second, second);
+    EXPECT_EQ(aligner.combined(), 2);
+
+    // Nor does one that went silent, until it speaks again
+    put(2, time_point{7ms}, {7});
+    put(0, time_point{1007ms}, {8, 8});
+    ASSERT_EQ(combined.size(), 3);
+    EXPECT_EQ(combined[2].first, time_point{1007ms});
+    const std::vector<uint8_t> third{8, 8};
+    ASSERT_ITERABLE_EQ(combined[2].second, third);
+    put(2, time_point{1008ms}, {9});
+    put(0, time_point{1009ms}, {10, 10});
+    ASSERT_EQ(combined.size(), 4);
+    const std::vector<uint8_t> fourth{10, 10, 9};
+    ASSERT_ITERABLE_EQ(combined[3].second, fourth);
+}
+
+TEST(SpectrumAlignerTest, ShouldNotWaitForASourceThatNeverSpeaks)
+{
+    using namespace std::chrono_literals;
+    using time_point = SpectrumAligner::Clock::time_point;
+    SpectrumAligner aligner{2, std::chrono::seconds{1}};
+    std::size_t combined = 0;
+    auto on_combined = [&combined](time_point, std::span<const uint8_t>) { ++combined; };
+    const std::vector<uint8_t> amplitudes{1, 2};
+
+    aligner.put(0, time_point{10s}, amplitudes, on_combined);
+    aligner.put(0, time_point{10s + 500ms}, amplitudes, on_combined);
+    EXPECT_EQ(combined, 0);
+    aligner.put(0, time_point{11s}, amplitudes, on_combined);
+    EXPECT_EQ(combined, 1);
+}
+
+TEST(MailboxTest, ShouldHandOverOnlyTheNewestValue)
+{
+    Mailbox<std::vector<int>> mailbox;
+    EXPECT_EQ(mailbox.take(), nullptr);
+
+    for (int i = 1; i <= 3; ++i)
+    {
+        mailbox.back().assign(4, i);
+        mailbox.publish();
+    }
+    const std::vector<int>* taken = mailbox.take();
+    ASSERT_NE(taken, nullptr);
+    const std::vector<int>& received_first = *taken;
+    const std::vector<int> newest(4, 3);
+    ASSERT_ITERABLE_EQ(received_first, newest);
+    EXPECT_EQ(mailbox.take(), nullptr);
+    EXPECT_EQ(mailbox.published(), 3);
+    EXPECT_EQ(mailbox.dropped(), 2);
+
+    // Across threads values arrive whole, in order, and each is either taken or dropped
+    constexpr int values = 100000;
+    std::atomic<bool> done = false;
+    auto produce = [&]()
+    {
+        for (int i = 4; i < 4 + values; ++i)
+        {
+            mailbox.back().assign(4, i);
+            mailbox.publish();
+        }
+        done = true;
+    };
+    std::thread producer{produce};
+
+    std::size_t torn = 0;
+    std::size_t out_of_order = 0;
+    uint64_t received = 0;
+    int last = 3;
+    auto consume = [&]()
+    {
+        const std::vector<int>* value = mailbox.take();
+        if (value == nullptr) return;
+        ++received;
+        if (std::ranges::count(*value, value->front()) != std::ssize(*value)) ++torn;
+        if (value->front() <= last) ++out_of_order;
+        last = value->front();
+    };
+    while (!done)
+        consume();
+    producer.join();
+    consume();
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(out_of_order, 0);
+    EXPECT_EQ(last, 3 + values);
+    EXPECT_EQ(mailbox.published(), 3 + values);
+    EXPECT_EQ(1 + received + mailbox.dropped(), mailbox.published());
+}
+
+TEST(TimerTest, ShouldCountExpirations)
+{
+    auto timer = Timer::create(std::chrono::milliseconds{1});
+    ASSERT_TRUE(timer.has_value()) << timer.error().message();
+    EXPECT_EQ(timer->expirations(), 0);
+
+    pollfd expired{.fd = timer->fd(), .events = POLLIN, .revents = 0};
+    ASSERT_EQ(poll(&expired, 1, 1000), 1);
+    EXPECT_GE(timer->expirations(), 1);
+}
+
+class CaptureTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        path = ::testing::TempDir() + "capture_test.micap";
+        auto writer = CaptureWriter::create(path.c_str());
+        ASSERT_TRUE(writer.has_value()) << writer.error().message();
+        for (uint32_t i = 0; i < entries; ++i)
+        {
+            std::vector<uint8_t> payload(i % 7, static_cast<uint8_t>(i));
+            const auto kind = i % 2 == 0 ? capture::Kind::SPECTRUM : capture::Kind::LINK_BYTES;
+            ASSERT_FALSE(writer->append(kind, at(i), payload));
+        }
+        ASSERT_FALSE(writer->finish());
+    }
+
+    void TearDown() override { std::remove(path.c_str()); }
+
+    static auto at(uint32_t i) -> std::chrono::steady_clock::time_point
+    {
+        return std::chrono::steady_clock::time_point{std::chrono::milliseconds{1000 + 10 * i}};
+    }
+
+    // Checks that the entries from `offset` on are the ones written from `first` on
+    static void expect_entries(const CaptureReader& reader, std::size_t offset, uint32_t first)
+    {
+        uint32_t i = first;
+        while (auto entry = reader.next(offset))
+        {
+            ASSERT_LT(i, entries);
+            EXPECT_EQ(entry->timestamp, at(i));
+            EXPECT_EQ(entry->kind,
+                      i % 2 == 0 ? capture::Kind::SPECTRUM : capture::Kind::LINK_BYTES);
+            const std::vector<uint8_t> payload(i % 7, static_cast<uint8_t>(i));
+            ASSERT_ITERABLE_EQ(entry->payload, payload);
+            ++i;
+        }
+        EXPECT_EQ(i, entries);
+    }
+
+    constexpr static uint32_t entries = 1000;
+    std::string path;
+};
+
+TEST_F(CaptureTest, ShouldReadBackEveryEntry)
+{
+    auto reader = CaptureReader::open(path.c_str());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+    expect_entries(*reader, reader->begin(), 0);
+}
+
+TEST_F(CaptureTest, ShouldSeekToTheFirstEntryNotBeforeATimestamp)
+{
+    auto reader = CaptureReader::open(path.c_str());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+    for (uint32_t i : {0U, 1U, 255U, 256U, 257U, 700U, entries - 1})
+        expect_entries(*reader, reader->seek(at(i) - std::chrono::milliseconds{5}), i);
+    expect_entries(*reader, reader->seek(at(entries)), entries);
+}
+
+TEST_F(CaptureTest, ShouldRecoverTheEntriesOfAnUnfinishedCapture)
+{
+    // Cuts the trailer, the index and half of the last entry off
+    struct stat status;
+    ASSERT_EQ(stat(path.c_str(), &status), 0);
+    const auto last_entry = sizeof(capture::EntryHeader) + (entries - 1) % 7;
+    const auto index_points = (entries + capture::index_stride - 1) / capture::index_stride;
+    const auto index_entry =
+        sizeof(capture::EntryHeader) + index_points * sizeof(capture::IndexPoint);
+    ASSERT_EQ(truncate(path.c_str(),
+                       status.st_size - sizeof(capture::Trailer) - index_entry - last_entry / 2),
+              0);
+
+    auto reader = CaptureReader::open(path.c_str());
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+    std::size_t offset = reader->seek(at(entries - 2));
+    auto entry = reader->next(offset);
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->timestamp, at(entries - 2));
+    EXPECT_FALSE(reader->next(offset).has_value());
+}
+
+TEST_F(CaptureTest, ShouldRejectAndUnmapAFileOfAnotherFormat)
+{
+    const int descriptor = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    ASSERT_GE(descriptor, 0);
+    const uint32_t magic = 0;
+    ASSERT_EQ(pwrite(descriptor, &magic, sizeof(magic), 0), sizeof(magic));
+    close(descriptor);
+
+    auto reader = CaptureReader::open(path.c_str());
+    ASSERT_FALSE(reader.has_value());
+    EXPECT_EQ(reader.error(), std::errc::wrong_protocol_type);
+    // The file must not stay mapped behind the error
+    std::ifstream maps{"/proc/self/maps"};
+    const std::string mapped{std::istreambuf_iterator<char>{maps}, {}};
+    EXPECT_EQ(mapped.find(path), std::string::npos);
+}
+
+TEST(SessionTest, ShouldSendAndReceiveOverOneLoop)
+{
+    const int board = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_GE(board, 0);
+    ASSERT_EQ(grantpt(board), 0);
+    ASSERT_EQ(unlockpt(board), 0);
+
+    auto loop = EventLoop::create();
+    ASSERT_TRUE(loop.has_value());
+    std::vector<uint16_t> received;
+    auto on_message = [&received](tl::expected<Message, Error> message)
+    {
+        ASSERT_TRUE(message.has_value());
+        received.push_back(std::visit([](const auto& m) { return m.id; }, message.value()));
+    };
+    auto session = Session::open(*loop, ptsname(board), 115200, 4, on_message, nullptr);
+    ASSERT_TRUE(session.has_value()) << session.error().message();
+
+    // Opening greets the board first, it ignores credits from a host it hasn't heard from
+    Receiver<max_encoded_size<Message>> board_receiver;
+    std::vector<uint16_t> sent;
+    std::array<uint8_t, 256> buffer;
+    while (sent.size() < 2)
+    {
+        pollfd readable{.fd = board, .events = POLLIN, .revents = 0};
+        ASSERT_EQ(poll(&readable, 1, 1000), 1);
+        const ssize_t len = read(board, buffer.data(), buffer.size());
+        ASSERT_GT(len, 0);
+        board_receiver.put(std::span<const uint8_t>{buffer.data(), static_cast<std::size_t>(len)},
+                           [&sent](tl::expected<Message, Error> message)
+                           {
+                               ASSERT_TRUE(message.has_value());
+                               sent.push_back(std::visit([](const auto& m) { return m.id; },
+                                                         message.value()));
+                           });
+    }
+    EXPECT_EQ(sent, (std::vector<uint16_t>{Heartbeat::id, StartStreamingData::id}));
+
+    std::array<uint8_t, 3> amplitudes{1, 2, 3};
+    FourierData data{amplitudes};
+    Sender<max_encoded_size<FourierData>, FdSink> board_sender{FdSink{board}};
+    ASSERT_FALSE(board_sender.send(data));
+    while (received.empty())
+        ASSERT_FALSE(loop->run_once(1000));
+    EXPECT_EQ(received, std::vector<uint16_t>{FourierData::id});
+
+    session.value().reset();
+    close(board);
+}
+
+TEST(LinkTest, ShouldKeepASimulatedBoardStreaming)
+{
+    const int controller = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_GE(controller, 0);
+    ASSERT_EQ(grantpt(controller), 0);
+    ASSERT_EQ(unlockpt(controller), 0);
+    SimulatedBoard board;
+    std::array<uint8_t, 256> buffer;
+    // Hands the board everything the link wrote, as it arrives on its receive ring
+    auto deliver = [&](SimulatedBoard::Clock::time_point now)
+    {
+        pollfd readable{.fd = controller, .events = POLLIN, .revents = 0};
+        ASSERT_EQ(poll(&readable, 1, 1000), 1);
+        const ssize_t len = read(controller, buffer.data(), buffer.size());
+        ASSERT_GT(len, 0);
+        board.receive({buffer.data(), static_cast<std::size_t>(len)}, now);
+    };
+
+    auto link = Link::open(ptsname(controller), 115200, 4);
+    ASSERT_TRUE(link.has_value()) << link.error().message();
+    const auto opened = SimulatedBoard::Clock::now();
+    deliver(opened);
+    EXPECT_TRUE(board.listening(opened));
+    EXPECT_EQ(board.credits(), 4);
+
+    // Heartbeats alone while frames keep coming
+    link.value()->heartbeat(opened + std::chrono::seconds{1});
+    deliver(opened + std::chrono::seconds{1});
+    EXPECT_EQ(board.credits(), 4);
+
+    // The heartbeat lapsed and took the credits along, the stalled link grants them again
+    std::array<uint16_t, SimulatedBoard::block_size> block{};
+    const auto stalled = opened + Link::stall_timeout + std::chrono::seconds{1};
+    EXPECT_FALSE(board.sample(block, 0.05F, stalled));
+    EXPECT_EQ(board.credits(), 0);
+    link.value()->heartbeat(stalled);
+    deliver(stalled);
+    EXPECT_EQ(board.credits(), 4);
+
+    link.value().reset();
+    close(controller);
+}
+
+struct Conversation
+{
+    tl::expected<Ack, Error> ack = tl::unexpected{Error::NO_ERROR};
+    std::vector<uint8_t> amplitudes;
+    tl::expected<FourierData, Error> late = tl::unexpected{Error::NO_ERROR};
+    bool done = false;
+};
+
+auto converse(AsyncLink& link, Conversation& conversation) -> Task<>
+{
+    using namespace std::chrono_literals;
+    conversation.ack =
+        co_await link.request<Ack>(StreamConfig{FrameEncoding::PACKED, 16, 5, 4}, 1s);
+    auto data = co_await link.next<FourierData>(1s);
+    if (data) conversation.amplitudes.assign(data->amplitudes.begin(), data->amplitudes.end());
+    conversation.late = co_await link.next<FourierData>(10ms);
+    conversation.done = true;
+}
+
+TEST(LinkTest, ShouldGiveUpOnABoardThatStopsReading)
+{
+    const int controller = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_GE(controller, 0);
+    ASSERT_EQ(grantpt(controller), 0);
+    ASSERT_EQ(unlockpt(controller), 0);
+    auto link = Link::open(ptsname(controller), 115200, 4);
+    ASSERT_TRUE(link.has_value()) << link.error().message();
+
+    // Nobody reads the board's end, so the terminal's buffers fill up
+    const std::array<uint8_t, 256> filler{};
+    while (write(link.value()->fd(), filler.data(), filler.size()) > 0)
+    {
+    }
+    ASSERT_EQ(errno, EAGAIN);
+
+    const auto before = std::chrono::steady_clock::now();
+    link.value()->heartbeat();
+    EXPECT_LT(std::chrono::steady_clock::now() - before, std::chrono::seconds{1});
+
+    link.value().reset();
+    close(controller);
+}
+
+TEST(AsyncLinkTest, ShouldRequestAwaitAndTimeOut)
+{
+    const int board = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_GE(board, 0);
+    ASSERT_EQ(grantpt(board), 0);
+    ASSERT_EQ(unlockpt(board), 0);
+
+    auto loop = EventLoop::create();
+    ASSERT_TRUE(loop.has_value());
+    auto link = AsyncLink::open(*loop, ptsname(board), 115200, 4);
+    ASSERT_TRUE(link.has_value()) << link.error().message();
+
+    // The board acks the stream config and follows it with a single spectrum
+    Receiver<max_encoded_size<Message>> board_receiver;
+    Sender<max_encoded_size<Ack, FourierData>, FdSink> board_sender{FdSink{board}};
+    std::array<uint8_t, 3> amplitudes{1, 2, 3};
+    std::array<uint8_t, 256> buffer;
+    auto on_command = [&](tl::expected<Message, Error> message)
+    {
+        if (!message.has_value() || !std::holds_alternative<StreamConfig>(message.value()))
+            return;
+        Ack ack{StreamConfig::id, Error::NO_ERROR};
+        FourierData data{amplitudes};
+        EXPECT_FALSE(board_sender.send(ack));
+        EXPECT_FALSE(board_sender.send(data));
+    };
+    auto on_board = [&](uint32_t)
+    {
+        const ssize_t len = read(board, buffer.data(), buffer.size());
+        if (len > 0)
+            board_receiver.put({buffer.data(), static_cast<std::size_t>(len)}, on_command);
+    };
+    ASSERT_FALSE(loop->add(board, EPOLLIN, on_board));
+
+    Conversation conversation;
+    spawn(converse(*link.value(), conversation));
+    for (int i = 0; i < 100 && !conversation.done; ++i)
+        ASSERT_FALSE(loop->run_once(1000));
+    ASSERT_TRUE(conversation.done);
+    ASSERT_TRUE(conversation.ack.has_value()) << static_cast<int>(conversation.ack.error());
+    EXPECT_EQ(conversation.ack->msg_id, StreamConfig::id);
+    EXPECT_EQ(conversation.amplitudes, (std::vector<uint8_t>{1, 2, 3}));
+    ASSERT_FALSE(conversation.late.has_value());
+    EXPECT_EQ(conversation.late.error(), Error::TIMED_OUT);
+
+    loop->remove(board);
+    link.value().reset();
+    close(board);
+}
+
+TEST(SimulatedBoardTest, ShouldStreamLikeTheFirmware)
+{
+    std::vector<uint8_t> commands;
+    auto to_commands = [&commands](std::span<const uint8_t> bytes)
+    { commands.insert(commands.end(), bytes.begin(), bytes.end()); };
+    Sender<max_encoded_size<Message>, decltype(to_commands)> host{to_commands};
+    SimulatedBoard board;
+    SignalSource source{10'000.F};
+    source.tones.push_back({.frequency = 1250.F}); // Bin 64 of a 512 point transform
+    std::array<uint16_t, SimulatedBoard::block_size> block;
+    source.fill(block);
+    const float dt = static_cast<float>(block.size()) / source.sample_rate();
+    const auto now = SimulatedBoard::Clock::now();
+
+    // Nothing goes out before the host says hello and grants credits, in that order
+    EXPECT_FALSE(board.sample(block, dt, now));
+    Heartbeat heartbeat{0};
+    StartStreamingData grant{2};
+    ASSERT_FALSE(host.send(grant));
+    board.receive(commands, now);
+    EXPECT_EQ(board.credits(), 0);
+    commands.clear();
+    // A band per bin from bin 1 on
+    SetFrequencyData freq_data{1, 1.F};
+    ASSERT_FALSE(host.send(heartbeat));
+    ASSERT_FALSE(host.send(grant));
+    ASSERT_FALSE(host.send(freq_data));
+    board.receive(commands, now);
+    EXPECT_TRUE(board.listening(now));
+    EXPECT_EQ(board.credits(), 2);
+
+    EXPECT_TRUE(board.sample(block, dt, now));
+    Receiver<max_encoded_size<Message>> receiver;
+    std::vector<uint8_t> amplitudes;
+    receiver.put(board.outbound(),
+                 [&amplitudes](tl::expected<Message, Error> message)
+                 {
+                     ASSERT_TRUE(message.has_value());
+                     const auto& data = std::get<FourierData>(message.value()).amplitudes;
+                     amplitudes.assign(data.begin(), data.end());
+                 });
+    ASSERT_EQ(amplitudes.size(), 255);
+    EXPECT_EQ(std::ranges::max_element(amplitudes) - amplitudes.begin(), 63);
+
+    // Credits run out, and so does the heartbeat
+    EXPECT_TRUE(board.sample(block, dt, now));
+    EXPECT_FALSE(board.sample(block, dt, now));
+    board.receive(commands, now);
+    EXPECT_FALSE(board.sample(block, dt, now + SimulatedBoard::heartbeat_timeout));
+    EXPECT_EQ(board.credits(), 0);
+}
+
+TEST(SignalSourceTest, ShouldLoopAWavFileMixedDown)
+{
+    const std::string path = ::testing::TempDir() + "signal_source_test.wav";
+    // 16 bit stereo at 8 kHz, two frames
+    const std::vector<uint8_t> wav{
+        'R', 'I', 'F', 'F', 44, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 2, 0, 0x40, 0x1F, 0, 0,
+        0, 0x7D, 0, 0, 4, 0, 16, 0,
+        'd', 'a', 't', 'a', 8, 0, 0, 0, 0, 0x40, 0, 0x40, 0, 0x80, 0, 0,
+    };
+    FILE* file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(std::fwrite(wav.data(), 1, wav.size(), file), wav.size());
+    std::fclose(file);
+
+    auto source = SignalSource::open_wav(path.c_str());
+    std::remove(path.c_str());
+    ASSERT_TRUE(source.has_value()) << source.error().message();
+    EXPECT_EQ(source->sample_rate(), 8000.F);
+    std::array<uint16_t, 5> samples;
+    source->fill(samples);
+    const std::array<uint16_t, 5> expected{3072, 1024, 3072, 1024, 3072};
+    ASSERT_ITERABLE_EQ(samples, expected);
+
+    auto missing = SignalSource::open_wav(::testing::TempDir().c_str());
+    EXPECT_FALSE(missing.has_value());
+}
+
+TEST(BarsTest, ShouldDrawAnEighthPerGlyph)
+{
+    const std::vector<float> heights{0.F, 0.5F, 1.F, 1.5F, -1.F};
+    std::string out = "x";
+    render_bars(heights, 2, out);
+    EXPECT_EQ(out, "x   ▄ \n ▄██ \n");
+
+    Screen screen;
+    screen.clear(2, heights.size());
+    render_bars(heights, 2, screen);
+    std::string drawn;
+    screen.flush(drawn);
+    EXPECT_EQ(drawn, "\x1b[2J\x1b[1;1H   ▄ \x1b[2;1H ▄██ ");
+}
+
+TEST(ScreenTest, ShouldOnlyRedrawChangedCells)
+{
+    Screen screen;
+    std::string out;
+    screen.clear(2, 3);
+    screen.put(0, 0, "▁");
+    screen.print(1, 0, "abcd");
+    screen.flush(out);
+    EXPECT_EQ(out, "\x1b[2J\x1b[1;1H▁  \x1b[2;1Habc");
+
+    // The same frame again costs nothing
+    out.clear();
+    screen.clear(2, 3);
+    screen.put(0, 0, "▁");
+    screen.print(1, 0, "abc");
+    screen.flush(out);
+    EXPECT_EQ(out, "");
+
+    // Close changes share a cursor move, distant ones get their own
+    out.clear();
+    screen.clear(2, 3);
+    screen.put(0, 0, "▁");
+    screen.put(0, 2, "█");
+    screen.print(1, 0, "xby");
+    screen.flush(out);
+    EXPECT_EQ(out, "\x1b[1;3H█\x1b[2;1Hxby");
+
+    // A new size starts over
+    out.clear();
+    screen.clear(1, 2);
+    screen.flush(out);
+    EXPECT_EQ(out, "\x1b[2J\x1b[1;1H  ");
+}
+
+TEST(WaterfallTest, ShouldScrollInOnlyTheNewRow)
+{
+    Waterfall waterfall{3};
+    const std::vector<float> quiet{0.F, 0.F};
+    const std::vector<float> loud{1.F, 2.F};
+    waterfall.push(quiet, 2.F);
+    waterfall.push(loud, 2.F);
+    EXPECT_EQ(waterfall.size(), 2);
+    const std::vector<uint8_t> newest = {13, 25};
+    const auto newest_row = waterfall.row(0);
+    ASSERT_ITERABLE_EQ(newest_row, newest);
+
+    // Nothing shown yet: the scroll region is set up and every line drawn, blank ones cleared
+    std::string out;
+    waterfall.draw(1, out);
+    EXPECT_EQ(out,
+              "\x1b[0m\x1b[2;4r"
+              "\x1b[2;1H\x1b[0m\x1b[2K"
+              "\x1b[3;1H\x1b[0m\x1b[2K\x1b[48;5;16m  "
+              "\x1b[4;1H\x1b[0m\x1b[2K\x1b[48;5;198m \x1b[48;5;231m "
+              "\x1b[0m");
+
+    // A new row scrolls the region and is the only one written
+    out.clear();
+    waterfall.push(quiet, 2.F);
+    waterfall.draw(1, out);
+    EXPECT_EQ(out, "\x1b[0m\x1b[1S\x1b[4;1H\x1b[0m\x1b[2K\x1b[48;5;16m  \x1b[0m");
+
+    // The oldest row makes room once the ring is full, a NaN counts as silence
+    const std::vector<float> odd{std::nanf(""), 4.F};
+    waterfall.push(odd, 2.F);
+    EXPECT_EQ(waterfall.size(), 3);
+    const std::vector<uint8_t> oldest = {13, 25};
+    const auto oldest_row = waterfall.row(2);
+    ASSERT_ITERABLE_EQ(oldest_row, oldest);
+    const std::vector<uint8_t> clipped = {0, 25};
+    const auto clipped_row = waterfall.row(0);
+    ASSERT_ITERABLE_EQ(clipped_row, clipped);
+
+    // Another width starts over
+    const std::vector<float> wider(4, 1.F);
+    waterfall.push(wider, 2.F);
+    EXPECT_EQ(waterfall.size(), 1);
+    EXPECT_EQ(waterfall.width(), 4);
+}
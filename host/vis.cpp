@@ -1,15 +1,33 @@
-#include <cassert>
-#include <cmath>
+#define MI_IMPLEMENT
+#include "bars.hpp"
+#include "fd_sink.hpp"
+#include "mailbox.hpp"
+#include "screen.hpp"
+#include "spectrum_record.hpp"
+#include "spectrum_ring.hpp"
+#include "waterfall.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fmt/format.h>
 #include <iostream>
-#include <limits>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
-struct
+struct Args : mi::ScaleOptions
 {
-    std::size_t lines = 1;
-    float max = std::numeric_limits<float>::infinity();
-    float min = std::numeric_limits<float>::lowest();
+    bool binary = false;
+    bool stream = false;
+    bool waterfall = false;
+    const char* shm = nullptr;
+    unsigned fps = 60;
 } args;
 
 void help(std::string_view program)
@@ -20,6 +38,12 @@ void help(std::string_view program)
                  "  -l, --lines <lines>  Number of lines to display\n"
                  "  --max <max>          Maximum value\n"
                  "  --min <min>          Minimum value\n"
+                 "  -s, --stream         Keep drawing every line of numbers, as recv prints them\n"
+                 "  --binary             Keep drawing the spectrum records of recv --binary\n"
+                 "  --shm <name>         Keep drawing the newest spectrum of recv --shm <name>\n"
+                 "  --fps <fps>          Redraws per second at most when streaming\n"
+                 "  --waterfall          Scroll a spectrogram of the last <lines> spectra instead\n"
+                 "                       of drawing bars, with --stream, --binary or --shm\n"
                  "  --help               Display this message\n";
     exit(EXIT_FAILURE);
 }
@@ -56,58 +80,287 @@ void parse_args(int argc, char** argv)
             }
             args.min = std::stof(argv[++i]);
         }
+        else if (arg == "-s" || arg == "--stream")
+        {
+            args.stream = true;
+        }
+        else if (arg == "--waterfall")
+        {
+            args.waterfall = true;
+        }
+        else if (arg == "--binary")
+        {
+            args.binary = true;
+        }
+        else if (arg == "--shm")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for --shm\n";
+                exit(EXIT_FAILURE);
+            }
+            args.shm = argv[++i];
+        }
+        else if (arg == "--fps")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing argument for --fps\n";
+                exit(EXIT_FAILURE);
+            }
+            args.fps = std::max(1UL, std::stoul(argv[++i]));
+        }
         else
         {
             help(argv[0]);
         }
     }
+    if (args.waterfall && args.shm == nullptr && !args.binary && !args.stream) help(argv[0]);
 }
 
 auto collect() -> std::vector<float>
 {
     std::vector<float> values;
     std::string value;
-    float max = std::numeric_limits<float>::lowest();
     while (std::cin >> value)
+        values.push_back(std::stof(value));
+
+    std::vector<float> heights;
+    mi::scale(std::span<const float>{values}, args, heights);
+    return heights;
+}
+
+// What the terminal shows, kept from frame to frame so a frame only writes the cells it changes
+mi::Screen screen;
+
+// The spectrogram of every spectrum decoded. Rows are added where spectra are decoded, so none is
+// lost to the display rate, and drawing only brings the terminal up to date with them.
+mi::Waterfall waterfall{0};
+std::mutex waterfall_mutex;
+
+// Scrolls a spectrum into the waterfall, on whichever thread decoded it
+void add_row(std::span<const float> heights)
+{
+    const std::lock_guard lock{waterfall_mutex};
+    waterfall.push(heights, static_cast<float>(args.lines));
+}
+
+// Written when a signal ends drawing, formatted up front as the handler can only write
+std::string restore_terminal;
+
+// Hides the cursor while drawing, and restores the terminal however drawing ends
+void start_drawing()
+{
+    restore_terminal = "\x1b[?25h\n";
+    if (args.waterfall)
     {
-        auto f = std::stof(value);
-        if (f < args.min) f = 0;
-        max = std::max(max, f);
-        values.push_back(f);
+        // Releasing the scroll region homes the cursor, so it's moved below the waterfall again
+        restore_terminal.clear();
+        mi::Waterfall::release(restore_terminal);
+        fmt::format_to(std::back_inserter(restore_terminal),
+                       "\x1b[{};1H\x1b[?25h\n",
+                       args.lines + 2);
     }
-    for (auto& f : values)
+    auto restore = [](int)
     {
-        f /= std::isfinite(args.max) ? args.max : max;
-        f *= args.lines;
+        (void)!write(STDOUT_FILENO, restore_terminal.data(), restore_terminal.size());
+        _exit(EXIT_SUCCESS);
+    };
+    std::signal(SIGINT, restore);
+    std::signal(SIGTERM, restore);
+    std::cout << (args.waterfall ? "\x1b[?25l\x1b[2J" : "\x1b[?25l") << std::flush;
+}
+
+void stop_drawing()
+{
+    std::string out;
+    if (args.waterfall) mi::Waterfall::release(out);
+    const std::size_t rows = args.waterfall ? args.lines + 1 : screen.rows();
+    fmt::format_to(std::back_inserter(out), "\x1b[{};1H\x1b[?25h", rows + 1);
+    std::cout << out << std::flush;
+}
+
+// Draws the bars in place, or scrolls in the waterfall rows added since the last time, with
+// `status` below them, in a single write
+void present(std::span<const float> heights, std::string_view status)
+{
+    static std::string out;
+    out.clear();
+    if (args.waterfall)
+    {
+        {
+            const std::lock_guard lock{waterfall_mutex};
+            waterfall.draw(0, out);
+        }
+        fmt::format_to(std::back_inserter(out), "\x1b[{};1H{}\x1b[K", args.lines + 1, status);
     }
-    return values;
+    else
+    {
+        screen.clear(args.lines + 1, std::max(heights.size(), status.size()));
+        mi::render_bars(heights, args.lines, screen);
+        screen.print(args.lines, 0, status);
+        screen.flush(out);
+    }
+    if (out.empty()) return;
+    mi::FdSink{STDOUT_FILENO}(std::span{reinterpret_cast<const uint8_t*>(out.data()), out.size()});
 }
 
-constexpr std::string_view blocks = "▁▂▃▄▅▆▇█";
-constexpr std::size_t unicode_size = sizeof("▂") - sizeof('\0');
-constexpr std::size_t n_blocks = blocks.size() / unicode_size;
-auto block(std::size_t index) -> std::string
+// Draws a spectrum in place, followed by how long ago it was read and `status`
+void draw(std::span<const float> heights,
+          std::chrono::steady_clock::time_point read_at,
+          std::string_view status)
 {
-    index -= 1;
-    if (index > std::numeric_limits<std::size_t>::max() / 2) return " ";
-    index = std::min(index, n_blocks - 1);
-    const static std::string str_blocks{blocks};
-    assert(index < n_blocks);
-    std::size_t inx = index * unicode_size;
-    return str_blocks.substr(inx, unicode_size);
+    static std::string line;
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - read_at;
+    line.clear();
+    fmt::format_to(std::back_inserter(line), "{:.2f} ms latency{}", latency.count(), status);
+    present(heights, line);
 }
 
-int main(int argc, char** argv)
+// A spectrum scaled to bar heights, on its way from the decoding thread to the drawing one
+struct Frame
 {
-    parse_args(argc, argv);
-    auto values = collect();
-    for (std::size_t line = args.lines; line != 0; --line)
+    std::vector<float> heights;
+    std::chrono::steady_clock::time_point read_at;
+};
+
+// Decodes every line of numbers, stamped with the time it was read
+void decode_text(mi::Mailbox<Frame>& mailbox)
+{
+    std::string line;
+    std::vector<float> values;
+    while (std::getline(std::cin, line))
+    {
+        values.clear();
+        const char* begin = line.c_str();
+        char* end = nullptr;
+        for (float value = std::strtof(begin, &end); end != begin;
+             value = std::strtof(begin, &end))
+        {
+            values.push_back(value);
+            begin = end;
+        }
+        if (values.empty()) continue;
+        Frame& frame = mailbox.back();
+        mi::scale(std::span<const float>{values}, args, frame.heights);
+        if (args.waterfall) add_row(frame.heights);
+        frame.read_at = std::chrono::steady_clock::now();
+        mailbox.publish();
+    }
+}
+
+// Decodes every spectrum record, stamped with the time recv read it
+void decode_records(mi::Mailbox<Frame>& mailbox)
+{
+    mi::SpectrumRecordReader reader;
+    std::array<uint8_t, 1 << 16> buffer;
+    auto on_record = [&](std::chrono::steady_clock::time_point timestamp,
+                         std::span<const uint8_t> amplitudes)
+    {
+        Frame& frame = mailbox.back();
+        mi::scale(amplitudes, args, frame.heights);
+        if (args.waterfall) add_row(frame.heights);
+        frame.read_at = timestamp;
+        mailbox.publish();
+    };
+
+    ssize_t len;
+    while ((len = read(STDIN_FILENO, buffer.data(), buffer.size())) > 0)
+        reader.put(std::span<const uint8_t>{buffer.data(), static_cast<std::size_t>(len)},
+                   on_record);
+}
+
+// Decodes on a thread of its own and draws the newest frame at the display rate, so input that
+// comes faster than the terminal can take never queues up in front of it: what's shown is at
+// most a frame interval behind what was decoded, and the frames the display skipped count as
+// dropped. A waterfall drops nothing, the decoder adds every frame to it as a row and a redraw
+// scrolls in all rows added since the last one.
+void decode_and_draw(void (*decode)(mi::Mailbox<Frame>&))
+{
+    mi::Mailbox<Frame> mailbox;
+    std::atomic<bool> decoded = false;
+    auto run_decoder = [&]()
+    {
+        decode(mailbox);
+        decoded.store(true, std::memory_order_release);
+    };
+    std::jthread decoder{run_decoder};
+
+    const auto interval = std::chrono::microseconds{1'000'000 / args.fps};
+    auto next_frame = std::chrono::steady_clock::now();
+    std::string status;
+    while (true)
     {
-        for (auto f : values)
+        // Checked before taking, so the last frame is drawn before stopping
+        const bool finished = decoded.load(std::memory_order_acquire);
+        if (const Frame* frame = mailbox.take())
         {
-            std::size_t scalar = (f - line + 1) * n_blocks;
-            std::cout << block(scalar);
+            status.clear();
+            if (args.waterfall)
+                fmt::format_to(std::back_inserter(status), " | {} rows", mailbox.published());
+            else
+                fmt::format_to(std::back_inserter(status),
+                               " | {} of {} dropped",
+                               mailbox.dropped(),
+                               mailbox.published());
+            draw(frame->heights, frame->read_at, status);
         }
-        std::cout << '\n';
+        if (finished) break;
+        // A slow frame delays the next one rather than making it up with a burst
+        next_frame = std::max(next_frame + interval, std::chrono::steady_clock::now());
+        std::this_thread::sleep_until(next_frame);
+    }
+}
+
+// Polls the shared memory ring at the display rate, reading it costs no system call
+void stream_ring()
+{
+    auto reader = mi::SpectrumRingReader::attach(args.shm);
+    if (!reader.has_value())
+    {
+        std::cerr << "Failed to attach to " << args.shm << ": " << reader.error().message()
+                  << '\n';
+        exit(EXIT_FAILURE);
+    }
+
+    const auto interval = std::chrono::microseconds{1'000'000 / args.fps};
+    auto next_frame = std::chrono::steady_clock::now();
+    std::string status;
+    std::vector<float> heights;
+    auto on_spectrum = [&](std::chrono::steady_clock::time_point read_at,
+                           std::span<const uint8_t> amplitudes)
+    {
+        status.clear();
+        fmt::format_to(std::back_inserter(status), " | {} skipped", reader->skipped());
+        mi::scale(amplitudes, args, heights);
+        if (args.waterfall) add_row(heights);
+        draw(heights, read_at, status);
+    };
+    while (true)
+    {
+        reader->latest(on_spectrum);
+        next_frame += interval;
+        std::this_thread::sleep_until(next_frame);
     }
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv)
+{
+    parse_args(argc, argv);
+    if (args.waterfall) waterfall = mi::Waterfall{args.lines};
+    if (args.shm != nullptr || args.binary || args.stream)
+    {
+        start_drawing();
+        if (args.shm != nullptr)
+            stream_ring();
+        else
+            decode_and_draw(args.binary ? decode_records : decode_text);
+        stop_drawing();
+        return 0;
+    }
+    auto heights = collect();
+    std::string out;
+    mi::render_bars(heights, args.lines, out);
+    std::cout << out;
+}